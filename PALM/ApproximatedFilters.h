@@ -0,0 +1,170 @@
+#ifndef PALM_APPROXIMATEDFILTERS_H
+#define PALM_APPROXIMATEDFILTERS_H
+
+#include <float.h>
+
+
+namespace palm
+{
+    // Number of hand-typed filters, covering moment orders up to 3
+    static const int APPROXIMATED_FILTER_COUNT = 8;
+
+    // Manually typed filter values for speed performance
+    static const double C_333 = 0.333333;
+    static const double C_111 = 0.111111;
+    static const double C_569 = 0.568627;
+    static const double C_294 = 0.294118;
+    static const double C_481 = 0.481481;
+    static const double C_037 = 0.037037;
+
+    // Evaluates the approximated Zernike filters on a 4x4 core and packs their signs into a pattern code.
+    // Declared static so that every instruction set variant of the kernels gets its own copy.
+    static inline unsigned char applyApproximatedFilters(const double v[4][4], int momentOrder)
+    {
+        unsigned char value = 0;
+
+        if (momentOrder > 0)
+        {
+            double v1 = -v[0][0] - v[0][1] * C_333 + v[0][2] * C_333 + v[0][3]
+                        - v[1][0] - v[1][1] * C_333 + v[1][2] * C_333 + v[1][3]
+                        - v[2][0] - v[2][1] * C_333 + v[2][2] * C_333 + v[2][3]
+                        - v[3][0] - v[3][1] * C_333 + v[3][2] * C_333 + v[3][3];
+            value |= (unsigned char) (v1 > 0) << 0;
+
+            double v2 = v[0][0] + v[0][1] + v[0][2] + v[0][3]
+                        + v[1][0] * C_333 + v[1][1] * C_333 + v[1][2] * C_333 + v[1][3] * C_333
+                        - v[2][0] * C_333 - v[2][1] * C_333 - v[2][2] * C_333 - v[2][3] * C_333
+                        - v[3][0] - v[3][1] - v[3][2] - v[3][3];
+            value |= (unsigned char) (v2 > 0) << 1;
+        }
+
+        if (momentOrder > 1)
+        {
+            double v3 = -v[0][1] - v[0][2] - v[3][1] - v[3][2] + v[1][0] + v[2][0] + v[1][3] + v[2][3];
+            value |= (unsigned char) (v3 > 0) << 2;
+
+            double v4 = -v[0][0] - v[0][1] * C_333 + v[0][2] * C_333 + v[0][3]
+                        - v[1][0] * C_333 - v[1][1] * C_111 + v[1][2] * C_111 + v[1][3] * C_333
+                        + v[2][0] * C_333 + v[2][1] * C_111 - v[2][2] * C_111 - v[2][3] * C_333
+                        + v[3][0] + v[3][1] * C_333 - v[3][2] * C_333 - v[3][3];
+            value |= (unsigned char) (v4 > 0) << 3;
+        }
+
+        if (momentOrder > 2)
+        {
+            double v5 = v[0][0] * C_294 + v[0][1] * C_333 - v[0][2] * C_333 - v[0][3] * C_294
+                        + v[1][0] + v[1][1] * C_569 - v[1][2] * C_569 - v[1][3]
+                        + v[2][0] + v[2][1] * C_569 - v[2][2] * C_569 - v[2][3]
+                        + v[3][0] * C_294 + v[3][1] * C_333 - v[3][2] * C_333 - v[3][3] * C_294;
+            value |= (unsigned char) (v5 > 0) << 4;
+
+            double v6 = -v[0][0] * C_294 - v[0][1] - v[0][2] - v[0][3] * C_294
+                        - v[1][0] * C_333 - v[1][1] * C_569 - v[1][2] * C_569 - v[1][3] * C_333
+                        + v[2][0] * C_333 + v[2][1] * C_569 + v[2][2] * C_569 + v[2][3] * C_333
+                        + v[3][0] * C_294 + v[3][1] + v[3][2] + v[3][3] * C_294;
+            value |= (unsigned char) (v6 > 0) << 5;
+
+            double v7 = v[0][0] + v[0][1] * C_481 - v[0][2] * C_481 - v[0][3]
+                        - v[1][0] * C_333 + v[1][1] * C_037 - v[1][2] * C_037 + v[1][3] * C_333
+                        - v[2][0] * C_333 + v[2][1] * C_037 - v[2][2] * C_037 + v[2][3] * C_333
+                        + v[3][0] + v[3][1] * C_481 - v[3][2] * C_481 - v[3][3];
+            value |= (unsigned char) (v7 > 0) << 6;
+
+            double v8 = v[0][0] - v[0][1] * C_333 - v[0][2] * C_333 + v[0][3]
+                        + v[1][0] * C_481 + v[1][1] * C_037 + v[1][2] * C_037 + v[1][3] * C_481
+                        - v[2][0] * C_481 - v[2][1] * C_037 - v[2][2] * C_037 - v[2][3] * C_481
+                        - v[3][0] + v[3][1] * C_333 + v[3][2] * C_333 - v[3][3];
+            value |= (unsigned char) (v8 > 0) << 7;
+        }
+
+        return value;
+    }
+
+    // Smaller of nearest and the magnitude of a filter response
+    static inline double nearestResponse(double nearest, double response)
+    {
+        double magnitude = response < 0 ? -response : response;
+        return magnitude < nearest ? magnitude : nearest;
+    }
+
+    // Same filters as applyApproximatedFilters on the mirrored bases of L cores. Element m[a][b][l] of core l combines
+    // rows 0 and 3, 1 and 2 (a) and columns 0 and 3, 1 and 2 (b) as their outer pair sum, inner pair sum, outer pair
+    // difference and inner pair difference, e.g. m[2][1] = (v01 + v02) - (v31 + v32). Every filter is symmetric or
+    // antisymmetric in both directions, so it weights four basis elements by its upper-left quadrant. The responses
+    // differ from the direct ones only by rounding; nearest receives the smallest response magnitude of every core,
+    // to tell the cores whose signs could differ.
+    template<int L>
+    static inline void applyMirroredApproximatedFilters(const double m[4][4][L], int momentOrder, unsigned int *values,
+                                                        double *nearest)
+    {
+        for (int l = 0; l < L; l++)
+        {
+            values[l] = 0;
+            nearest[l] = DBL_MAX;
+        }
+
+        if (momentOrder > 0)
+        {
+            for (int l = 0; l < L; l++)
+            {
+                double v1 = -m[0][2][l] - m[0][3][l] * C_333 - m[1][2][l] - m[1][3][l] * C_333;
+                double v2 = m[2][0][l] + m[2][1][l] + m[3][0][l] * C_333 + m[3][1][l] * C_333;
+                values[l] |= (unsigned int) (v1 > 0) << 0 | (unsigned int) (v2 > 0) << 1;
+                nearest[l] = nearestResponse(nearestResponse(nearest[l], v1), v2);
+            }
+        }
+
+        if (momentOrder > 1)
+        {
+            for (int l = 0; l < L; l++)
+            {
+                double v3 = -m[0][1][l] + m[1][0][l];
+                double v4 = -m[2][2][l] - m[2][3][l] * C_333 - m[3][2][l] * C_333 - m[3][3][l] * C_111;
+                values[l] |= (unsigned int) (v3 > 0) << 2 | (unsigned int) (v4 > 0) << 3;
+                nearest[l] = nearestResponse(nearestResponse(nearest[l], v3), v4);
+            }
+        }
+
+        if (momentOrder > 2)
+        {
+            for (int l = 0; l < L; l++)
+            {
+                double v5 = m[0][2][l] * C_294 + m[0][3][l] * C_333 + m[1][2][l] + m[1][3][l] * C_569;
+                double v6 = -m[2][0][l] * C_294 - m[2][1][l] - m[3][0][l] * C_333 - m[3][1][l] * C_569;
+                double v7 = m[0][2][l] + m[0][3][l] * C_481 - m[1][2][l] * C_333 + m[1][3][l] * C_037;
+                double v8 = m[2][0][l] - m[2][1][l] * C_333 + m[3][0][l] * C_481 + m[3][1][l] * C_037;
+                values[l] |= (unsigned int) (v5 > 0) << 4 | (unsigned int) (v6 > 0) << 5 |
+                             (unsigned int) (v7 > 0) << 6 | (unsigned int) (v8 > 0) << 7;
+                nearest[l] = nearestResponse(nearestResponse(nearest[l], v5), v6);
+                nearest[l] = nearestResponse(nearestResponse(nearest[l], v7), v8);
+            }
+        }
+    }
+
+    // Evaluates additional 4x4 core filters, stored one after another in row-major order, and packs their signs into
+    // the code bits starting at firstBit
+    static inline unsigned short applyCoreFilters(const double v[4][4], const double *filters, int count, int firstBit)
+    {
+        unsigned short value = 0;
+
+        for (int k = 0; k < count; k++)
+        {
+            const double *filter = filters + 16 * k;
+
+            double sum = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    sum += v[i][j] * filter[4 * i + j];
+                }
+            }
+
+            value |= (unsigned short) (sum > 0) << (firstBit + k);
+        }
+
+        return value;
+    }
+}
+
+#endif //PALM_APPROXIMATEDFILTERS_H
@@ -0,0 +1,222 @@
+#include "BoundedL1Distance.h"
+#include "Kernels.h"
+#include <algorithm>
+
+using namespace palm;
+
+
+TopMatches::TopMatches(int k)
+        : _k(k)
+{
+    CV_Assert(k > 0);
+
+    _Heap.reserve((size_t) k);
+}
+
+double TopMatches::bound() const
+{
+    return _Heap.size() < (size_t) _k ? std::numeric_limits<double>::infinity() : _Heap.front().distance;
+}
+
+bool TopMatches::push(int index, double distance)
+{
+    DescriptorMatch match(index, distance);
+
+    if (_Heap.size() < (size_t) _k)
+    {
+        _Heap.push_back(match);
+        std::push_heap(_Heap.begin(), _Heap.end());
+        return true;
+    }
+
+    if (match < _Heap.front())
+    {
+        std::pop_heap(_Heap.begin(), _Heap.end());
+        _Heap.back() = match;
+        std::push_heap(_Heap.begin(), _Heap.end());
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<DescriptorMatch> TopMatches::sorted() const
+{
+    std::vector<DescriptorMatch> matches = _Heap;
+    std::sort(matches.begin(), matches.end());
+
+    return matches;
+}
+
+
+BoundedL1Distance::BoundedL1Distance(int descriptorSize, int cellLength, int blockCells)
+{
+    CV_Assert(cellLength > 0 && descriptorSize > 0 && descriptorSize % cellLength == 0);
+
+    _descriptorSize = descriptorSize;
+    _cellLength = cellLength;
+    _cellCount = descriptorSize / cellLength;
+
+    setBlockCells(blockCells);
+    resetCellOrder();
+}
+
+void BoundedL1Distance::setBlockCells(int blockCells)
+{
+    CV_Assert(blockCells > 0);
+
+    _blockCells = blockCells;
+}
+
+void BoundedL1Distance::setCellOrder(const std::vector<int> &cellOrder)
+{
+    CV_Assert(cellOrder.size() == (size_t) _cellCount);
+
+    std::vector<bool> seen((size_t) _cellCount, false);
+    _identityOrder = true;
+
+    for (int i = 0; i < _cellCount; i++)
+    {
+        CV_Assert(cellOrder[i] >= 0 && cellOrder[i] < _cellCount && !seen[cellOrder[i]]);
+
+        seen[cellOrder[i]] = true;
+        _identityOrder = _identityOrder && cellOrder[i] == i;
+    }
+
+    _CellOrder = cellOrder;
+}
+
+void BoundedL1Distance::resetCellOrder()
+{
+    _CellOrder.resize((size_t) _cellCount);
+    for (int i = 0; i < _cellCount; i++)
+    {
+        _CellOrder[i] = i;
+    }
+
+    _identityOrder = true;
+}
+
+void BoundedL1Distance::learnCellOrder(const cv::Mat &descriptors)
+{
+    CV_Assert(descriptors.type() == CV_64F && descriptors.cols == _descriptorSize && descriptors.rows > 1);
+
+    // Cells whose bins vary most across the map separate places best, so they are visited first
+    cv::Mat mean;
+    cv::reduce(descriptors, mean, 0, cv::REDUCE_AVG);
+
+    std::vector<double> cellVariance((size_t) _cellCount, 0.0);
+    for (int i = 0; i < descriptors.rows; i++)
+    {
+        const double *desc = descriptors.ptr<double>(i);
+        const double *mu = mean.ptr<double>(0);
+
+        for (int j = 0; j < _descriptorSize; j++)
+        {
+            double d = desc[j] - mu[j];
+            cellVariance[j / _cellLength] += d * d;
+        }
+    }
+
+    std::vector<int> order((size_t) _cellCount);
+    for (int i = 0; i < _cellCount; i++)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&cellVariance](int a, int b)
+    {
+        return cellVariance[a] > cellVariance[b];
+    });
+
+    setCellOrder(order);
+}
+
+double BoundedL1Distance::compute(const double *desc1, const double *desc2, double bound) const
+{
+    const KernelTable &kernel = kernels();
+
+    double sum = 0;
+    if (_identityOrder)
+    {
+        int blockLength = _blockCells * _cellLength;
+        for (int offset = 0; offset < _descriptorSize; offset += blockLength)
+        {
+            int length = std::min(blockLength, _descriptorSize - offset);
+            sum += kernel.l1Distance(desc1 + offset, desc2 + offset, length);
+
+            if (sum > bound)
+            {
+                return sum;
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < _cellCount; i++)
+        {
+            int offset = _CellOrder[i] * _cellLength;
+            sum += kernel.l1Distance(desc1 + offset, desc2 + offset, _cellLength);
+
+            if ((i + 1) % _blockCells == 0 && sum > bound)
+            {
+                return sum;
+            }
+        }
+    }
+
+    return sum;
+}
+
+double BoundedL1Distance::compute(const cv::Mat &desc1, const cv::Mat &desc2, double bound) const
+{
+    CV_Assert(desc1.type() == CV_64F && desc2.type() == CV_64F);
+    CV_Assert(desc1.rows == 1 && desc2.rows == 1 && desc1.cols == _descriptorSize && desc2.cols == _descriptorSize);
+
+    return compute(desc1.ptr<double>(0), desc2.ptr<double>(0), bound);
+}
+
+std::vector<DescriptorMatch> BoundedL1Distance::search(const cv::Mat &query, const cv::Mat &database, int k) const
+{
+    CV_Assert(k > 0);
+    CV_Assert(query.type() == CV_64F && query.rows == 1 && query.cols == _descriptorSize);
+    CV_Assert(database.type() == CV_64F && database.cols == _descriptorSize);
+
+    TopMatches matches(k);
+    for (int i = 0; i < database.rows; i++)
+    {
+        double bound = matches.bound();
+        double distance = compute(query.ptr<double>(0), database.ptr<double>(i), bound);
+
+        if (distance <= bound)
+        {
+            matches.push(i, distance);
+        }
+    }
+
+    return matches.sorted();
+}
+
+std::vector<DescriptorMatch> BoundedL1Distance::rerank(const cv::Mat &query, const cv::Mat &database,
+                                                       const std::vector<int> &candidates, int k) const
+{
+    CV_Assert(k > 0);
+    CV_Assert(query.type() == CV_64F && query.rows == 1 && query.cols == _descriptorSize);
+    CV_Assert(database.type() == CV_64F && database.cols == _descriptorSize);
+
+    TopMatches matches(k);
+    for (int candidate : candidates)
+    {
+        CV_Assert(candidate >= 0 && candidate < database.rows);
+
+        double bound = matches.bound();
+        double distance = compute(query.ptr<double>(0), database.ptr<double>(candidate), bound);
+
+        if (distance <= bound)
+        {
+            matches.push(candidate, distance);
+        }
+    }
+
+    return matches.sorted();
+}
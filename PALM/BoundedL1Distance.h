@@ -0,0 +1,80 @@
+#ifndef PALM_BOUNDEDL1DISTANCE_H
+#define PALM_BOUNDEDL1DISTANCE_H
+
+#include <limits>
+#include <opencv2/core.hpp>
+
+
+namespace palm
+{
+    class DescriptorMatch
+    {
+    public:
+        DescriptorMatch(int index = -1, double distance = std::numeric_limits<double>::infinity())
+                : index(index), distance(distance) { }
+
+        bool operator<(const DescriptorMatch &other) const
+        {
+            return distance < other.distance || (distance == other.distance && index < other.index);
+        }
+
+        int index;
+        double distance;
+    };
+
+
+    // Keeps the k best matches seen so far; bound() is the distance a candidate has to beat
+    class TopMatches
+    {
+    public:
+        TopMatches(int k);
+
+        int k() const { return _k; }
+        double bound() const;
+        bool push(int index, double distance);
+        std::vector<DescriptorMatch> sorted() const;
+
+    private:
+        int _k;
+        std::vector<DescriptorMatch> _Heap;
+    };
+
+
+    // L1 distance that accumulates cell by cell and stops as soon as the partial sum exceeds a bound. The result is
+    // exact when it does not exceed the bound, otherwise it is a lower bound of the true distance.
+    class BoundedL1Distance
+    {
+    public:
+        BoundedL1Distance(int descriptorSize, int cellLength, int blockCells = 4);
+        virtual ~BoundedL1Distance() { };
+
+        int descriptorSize() const { return _descriptorSize; }
+        int getCellLength() const { return _cellLength; }
+
+        int getBlockCells() const { return _blockCells; }
+        void setBlockCells(int blockCells);
+
+        std::vector<int> getCellOrder() const { return _CellOrder; }
+        void setCellOrder(const std::vector<int> &cellOrder);
+        void resetCellOrder();
+        void learnCellOrder(const cv::Mat &descriptors);
+
+        double compute(const double *desc1, const double *desc2, double bound) const;
+        double compute(const cv::Mat &desc1, const cv::Mat &desc2,
+                       double bound = std::numeric_limits<double>::infinity()) const;
+
+        std::vector<DescriptorMatch> search(const cv::Mat &query, const cv::Mat &database, int k) const;
+        std::vector<DescriptorMatch> rerank(const cv::Mat &query, const cv::Mat &database,
+                                            const std::vector<int> &candidates, int k) const;
+
+    private:
+        int _descriptorSize;
+        int _cellLength;
+        int _cellCount;
+        int _blockCells;
+        bool _identityOrder;
+        std::vector<int> _CellOrder;
+    };
+}
+
+#endif //PALM_BOUNDEDL1DISTANCE_H
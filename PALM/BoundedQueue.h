@@ -0,0 +1,136 @@
+#ifndef PALM_BOUNDEDQUEUE_H
+#define PALM_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <opencv2/core.hpp>
+
+
+namespace palm
+{
+    // Lock-free bounded multi-producer/multi-consumer ring buffer (Vyukov). Capacity is rounded up to a power of two.
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(size_t capacity)
+        {
+            CV_Assert(capacity > 0);
+
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            _mask = size - 1;
+            _Cells.reset(new Cell[size]);
+            for (size_t i = 0; i < size; i++)
+            {
+                _Cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            _enqueuePos.store(0, std::memory_order_relaxed);
+            _dequeuePos.store(0, std::memory_order_relaxed);
+        }
+
+        BoundedQueue(const BoundedQueue &) = delete;
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        size_t capacity() const { return _mask + 1; }
+
+        size_t size() const
+        {
+            size_t enqueuePos = _enqueuePos.load(std::memory_order_relaxed);
+            size_t dequeuePos = _dequeuePos.load(std::memory_order_relaxed);
+            return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        bool tryPush(const T &value)
+        {
+            Cell *cell;
+            size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                cell = &_Cells[pos & _mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+                if (diff == 0)
+                {
+                    if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // Full
+                }
+                else
+                {
+                    pos = _enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->data = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool tryPop(T &value)
+        {
+            Cell *cell;
+            size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                cell = &_Cells[pos & _mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+
+                if (diff == 0)
+                {
+                    if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // Empty
+                }
+                else
+                {
+                    pos = _dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = cell->data;
+            cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> _Cells;
+        size_t _mask;
+
+        // Keep producer and consumer positions on separate cache lines
+        char _padding0[64];
+        std::atomic<size_t> _enqueuePos;
+        char _padding1[64];
+        std::atomic<size_t> _dequeuePos;
+    };
+}
+
+#endif //PALM_BOUNDEDQUEUE_H
@@ -0,0 +1,99 @@
+#include "ConcurrentDescriptorStore.h"
+#include <algorithm>
+
+using namespace palm;
+
+
+ConcurrentDescriptorStore::ConcurrentDescriptorStore(int descriptorSize, int cellLength, int chunkSize, int maxChunks)
+        : _descriptorSize(descriptorSize), _chunkSize(chunkSize), _maxChunks(maxChunks),
+          _Distance(descriptorSize, cellLength), _size(0)
+{
+    CV_Assert(chunkSize > 0 && maxChunks > 0);
+    CV_Assert((long long) chunkSize * maxChunks <= std::numeric_limits<int>::max());
+
+    _Chunks.reset(new std::atomic<double *>[maxChunks]);
+    for (int c = 0; c < maxChunks; c++)
+    {
+        _Chunks[c].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ConcurrentDescriptorStore::~ConcurrentDescriptorStore()
+{
+    for (int c = 0; c < _maxChunks; c++)
+    {
+        delete[] _Chunks[c].load(std::memory_order_relaxed);
+    }
+}
+
+int ConcurrentDescriptorStore::add(const cv::Mat &descriptor)
+{
+    CV_Assert(descriptor.type() == CV_64F && descriptor.rows == 1 && descriptor.cols == _descriptorSize);
+
+    int index = _size.load(std::memory_order_relaxed);
+    int chunk = index / _chunkSize;
+    CV_Assert(chunk < _maxChunks);
+
+    double *data = _Chunks[chunk].load(std::memory_order_relaxed);
+    if (data == nullptr)
+    {
+        data = new double[(size_t) _chunkSize * _descriptorSize];
+        _Chunks[chunk].store(data, std::memory_order_release);
+    }
+
+    const double *values = descriptor.ptr<double>(0);
+    std::copy(values, values + _descriptorSize, data + (size_t) (index % _chunkSize) * _descriptorSize);
+
+    // Publishing the size releases the descriptor to every reader that acquires the new size
+    _size.store(index + 1, std::memory_order_release);
+
+    return index;
+}
+
+const double *ConcurrentDescriptorStore::row(int index) const
+{
+    const double *data = _Chunks[index / _chunkSize].load(std::memory_order_acquire);
+
+    return data + (size_t) (index % _chunkSize) * _descriptorSize;
+}
+
+cv::Mat ConcurrentDescriptorStore::descriptor(int index) const
+{
+    CV_Assert(index >= 0 && index < snapshot());
+
+    return cv::Mat(1, _descriptorSize, CV_64F, const_cast<double *>(row(index)));
+}
+
+std::vector<DescriptorMatch> ConcurrentDescriptorStore::search(const cv::Mat &query, int k) const
+{
+    return search(query, k, snapshot());
+}
+
+std::vector<DescriptorMatch> ConcurrentDescriptorStore::search(const cv::Mat &query, int k, int snapshot) const
+{
+    CV_Assert(k > 0);
+    CV_Assert(query.type() == CV_64F && query.rows == 1 && query.cols == _descriptorSize);
+    CV_Assert(snapshot >= 0 && snapshot <= this->snapshot());
+
+    TopMatches matches(k);
+    const double *q = query.ptr<double>(0);
+
+    for (int first = 0; first < snapshot; first += _chunkSize)
+    {
+        const double *data = row(first);
+        int count = std::min(_chunkSize, snapshot - first);
+
+        for (int i = 0; i < count; i++)
+        {
+            double bound = matches.bound();
+            double distance = _Distance.compute(q, data + (size_t) i * _descriptorSize, bound);
+
+            if (distance <= bound)
+            {
+                matches.push(first + i, distance);
+            }
+        }
+    }
+
+    return matches.sorted();
+}
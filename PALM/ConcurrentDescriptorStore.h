@@ -0,0 +1,49 @@
+#ifndef PALM_CONCURRENTDESCRIPTORSTORE_H
+#define PALM_CONCURRENTDESCRIPTORSTORE_H
+
+#include <atomic>
+#include <memory>
+#include "BoundedL1Distance.h"
+
+
+namespace palm
+{
+    // Descriptor store for one writer thread and any number of reader threads. Descriptors live in fixed-size
+    // chunks reached through a directory that is allocated once, so stored descriptors never move. The writer
+    // fills the next slot and then publishes the new size; readers take the size as a snapshot and see a
+    // consistent prefix of the store without taking any lock.
+    class ConcurrentDescriptorStore
+    {
+    public:
+        ConcurrentDescriptorStore(int descriptorSize, int cellLength, int chunkSize = 1024, int maxChunks = 4096);
+        virtual ~ConcurrentDescriptorStore();
+
+        int descriptorSize() const { return _descriptorSize; }
+        int chunkSize() const { return _chunkSize; }
+        long long capacity() const { return (long long) _chunkSize * _maxChunks; }
+        const BoundedL1Distance &distance() const { return _Distance; }
+
+        // Writer side; add() calls must not overlap. Returns the index of the descriptor.
+        int add(const cv::Mat &descriptor);
+
+        // Reader side. A snapshot is the number of descriptors visible at the time it was taken.
+        int snapshot() const { return _size.load(std::memory_order_acquire); }
+        int size() const { return snapshot(); }
+        cv::Mat descriptor(int index) const; // Read-only view into the store, valid for the lifetime of the store
+
+        std::vector<DescriptorMatch> search(const cv::Mat &query, int k) const;
+        std::vector<DescriptorMatch> search(const cv::Mat &query, int k, int snapshot) const;
+
+    private:
+        const double *row(int index) const;
+
+        int _descriptorSize;
+        int _chunkSize;
+        int _maxChunks;
+        BoundedL1Distance _Distance;
+        std::unique_ptr<std::atomic<double *>[]> _Chunks;
+        std::atomic<int> _size;
+    };
+}
+
+#endif //PALM_CONCURRENTDESCRIPTORSTORE_H
@@ -0,0 +1,130 @@
+#include "CpuFeatures.h"
+#include <atomic>
+#include <cstdlib>
+#include <opencv2/core.hpp>
+
+using namespace palm;
+
+
+static std::atomic<int> activeIsa(-1); // -1 until resolved from the environment or the CPU
+
+static bool cpuSupports(CpuIsa isa)
+{
+    switch (isa)
+    {
+        case CpuIsa::Baseline:
+            return true;
+
+#if defined(PALM_KERNELS_X86) && defined(__GNUC__)
+        case CpuIsa::SSE42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+
+        case CpuIsa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+
+        case CpuIsa::AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f");
+#endif
+
+#if defined(PALM_KERNELS_NEON)
+        case CpuIsa::NEON:
+            return true; // Mandatory on AArch64
+#endif
+
+        default:
+            return false;
+    }
+}
+
+CpuIsa palm::detectCpuIsa()
+{
+    const CpuIsa candidates[] = {CpuIsa::AVX512, CpuIsa::AVX2, CpuIsa::SSE42, CpuIsa::NEON};
+
+    for (CpuIsa isa : candidates)
+    {
+        if (cpuSupports(isa))
+        {
+            return isa;
+        }
+    }
+
+    return CpuIsa::Baseline;
+}
+
+bool palm::isCpuIsaSupported(CpuIsa isa)
+{
+    return cpuSupports(isa);
+}
+
+const char *palm::cpuIsaName(CpuIsa isa)
+{
+    switch (isa)
+    {
+        case CpuIsa::Baseline:
+            return "baseline";
+        case CpuIsa::SSE42:
+            return "sse42";
+        case CpuIsa::AVX2:
+            return "avx2";
+        case CpuIsa::AVX512:
+            return "avx512";
+        case CpuIsa::NEON:
+            return "neon";
+    }
+
+    return "unknown";
+}
+
+bool palm::parseCpuIsa(const std::string &name, CpuIsa &isa)
+{
+    const CpuIsa all[] = {CpuIsa::Baseline, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512, CpuIsa::NEON};
+
+    for (CpuIsa candidate : all)
+    {
+        if (name == cpuIsaName(candidate))
+        {
+            isa = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+CpuIsa palm::activeCpuIsa()
+{
+    int isa = activeIsa.load(std::memory_order_acquire);
+    if (isa >= 0)
+    {
+        return (CpuIsa) isa;
+    }
+
+    CpuIsa resolved = detectCpuIsa();
+
+    // An unknown or unsupported override falls back to the detected instruction set
+    const char *requestedName = std::getenv("PALM_CPU_ISA");
+    CpuIsa requested;
+    if (requestedName != nullptr && parseCpuIsa(requestedName, requested) && isCpuIsaSupported(requested))
+    {
+        resolved = requested;
+    }
+
+    activeIsa.store((int) resolved, std::memory_order_release);
+
+    return resolved;
+}
+
+void palm::setCpuIsa(CpuIsa isa)
+{
+    CV_Assert(isCpuIsaSupported(isa));
+
+    activeIsa.store((int) isa, std::memory_order_release);
+}
+
+void palm::resetCpuIsa()
+{
+    activeIsa.store(-1, std::memory_order_release);
+}
@@ -0,0 +1,24 @@
+#ifndef PALM_CPUFEATURES_H
+#define PALM_CPUFEATURES_H
+
+#include <string>
+#include "CpuIsa.h"
+
+
+namespace palm
+{
+    // Best instruction set that is both supported by the running CPU and compiled into the library
+    CpuIsa detectCpuIsa();
+
+    bool isCpuIsaSupported(CpuIsa isa);
+    const char *cpuIsaName(CpuIsa isa);
+    bool parseCpuIsa(const std::string &name, CpuIsa &isa);
+
+    // Instruction set used by the kernels. Defaults to detectCpuIsa() unless overridden by setCpuIsa() or the
+    // PALM_CPU_ISA environment variable (baseline, sse42, avx2, avx512, neon).
+    CpuIsa activeCpuIsa();
+    void setCpuIsa(CpuIsa isa);
+    void resetCpuIsa();
+}
+
+#endif //PALM_CPUFEATURES_H
@@ -0,0 +1,18 @@
+#ifndef PALM_CPUISA_H
+#define PALM_CPUISA_H
+
+
+namespace palm
+{
+    // Kept apart from CpuFeatures.h so that the kernel headers need no standard library header, see CMakeLists.txt
+    enum class CpuIsa
+    {
+        Baseline,
+        SSE42,
+        AVX2,
+        AVX512,
+        NEON
+    };
+}
+
+#endif //PALM_CPUISA_H
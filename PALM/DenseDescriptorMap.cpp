@@ -0,0 +1,219 @@
+#include "DenseDescriptorMap.h"
+#include <algorithm>
+
+using namespace palm;
+
+
+DenseDescriptorMap::DenseDescriptorMap(PALMConfig config, int weightSubdivisions)
+        : _config(config)
+{
+    setWeightSubdivisions(weightSubdivisions);
+
+    _PALM = new PALM(config, true);
+    _HistogramBuilder = _PALM->histogramBuilder();
+}
+
+void DenseDescriptorMap::setWeightSubdivisions(int weightSubdivisions)
+{
+    CV_Assert(weightSubdivisions >= 0);
+
+    _weightSubdivisions = weightSubdivisions;
+}
+
+int DenseDescriptorMap::descriptorSize() const
+{
+    return _PALM->descriptorSize();
+}
+
+void DenseDescriptorMap::build(const cv::Mat &image)
+{
+    CV_Assert(!image.empty());
+
+    cv::Mat patterns = _PALM->extractPatterns(image);
+    CV_Assert(patterns.type() == CV_8U || patterns.type() == CV_16U);
+
+    int rows = patterns.rows;
+    int cols = patterns.cols;
+    int binCount = _HistogramBuilder->getBinCount();
+    size_t stride = (size_t) (cols + 1) * binCount;
+
+    int groupBits = _HistogramBuilder->getGroupBits();
+    int groupCount = _HistogramBuilder->groupCount();
+    unsigned int mask = (1u << groupBits) - 1;
+
+    // Prefix counts over rows and columns, one vector of bin counts per corner
+    CV_Assert((long long) (rows + 1) * stride * sizeof(int) <= MAX_INTEGRAL_BYTES);
+    _Integral.assign((size_t) (rows + 1) * stride, 0);
+
+    std::vector<int> rowCounts((size_t) binCount);
+    for (int y = 0; y < rows; y++)
+    {
+        std::fill(rowCounts.begin(), rowCounts.end(), 0);
+
+        const uchar *codes = patterns.ptr<uchar>(y);
+        const ushort *wideCodes = patterns.ptr<ushort>(y);
+        const int *above = &_Integral[(size_t) y * stride + binCount];
+        int *current = &_Integral[(size_t) (y + 1) * stride + binCount];
+
+        for (int x = 0; x < cols; x++)
+        {
+            unsigned int code = patterns.depth() == CV_8U ? codes[x] : wideCodes[x];
+            for (int g = 0; g < groupCount; g++)
+            {
+                rowCounts[(g << groupBits) + ((code >> (g * groupBits)) & mask)]++;
+            }
+
+            for (int bin = 0; bin < binCount; bin++)
+            {
+                current[bin] = above[bin] + rowCounts[bin];
+            }
+
+            above += binCount;
+            current += binCount;
+        }
+    }
+
+    _imageSize = image.size();
+    _PatternImage = patterns;
+}
+
+cv::Mat DenseDescriptorMap::compute(const cv::Rect &window)
+{
+    cv::Mat descriptor(1, descriptorSize(), CV_64F);
+    computeWindow(window, descriptor.ptr<double>(0));
+
+    return descriptor;
+}
+
+cv::Mat DenseDescriptorMap::compute(const std::vector<cv::Rect> &windows)
+{
+    CV_Assert(windows.size() > 0);
+
+    cv::Mat descriptors((int) windows.size(), descriptorSize(), CV_64F);
+    for (int i = 0; i < windows.size(); i++)
+    {
+        computeWindow(windows[i], descriptors.ptr<double>(i));
+    }
+
+    return descriptors;
+}
+
+cv::Mat DenseDescriptorMap::compute(cv::Size windowSize, cv::Size stride, std::vector<cv::Rect> &windows)
+{
+    CV_Assert(isBuilt());
+    CV_Assert(stride.width > 0 && stride.height > 0);
+    CV_Assert(windowSize.width <= _imageSize.width && windowSize.height <= _imageSize.height);
+
+    windows.clear();
+    for (int y = 0; y + windowSize.height <= _imageSize.height; y += stride.height)
+    {
+        for (int x = 0; x + windowSize.width <= _imageSize.width; x += stride.width)
+        {
+            windows.push_back(cv::Rect(x, y, windowSize.width, windowSize.height));
+        }
+    }
+
+    return compute(windows);
+}
+
+const std::vector<DenseDescriptorMap::CellBlock> &DenseDescriptorMap::getCellBlocks(cv::Size regionSize)
+{
+    std::pair<int, int> key(regionSize.width, regionSize.height);
+
+    std::map<std::pair<int, int>, cv::Mat>::iterator kernel = _GaussianKernels.find(key);
+    if (kernel == _GaussianKernels.end())
+    {
+        cv::Mat gaussianKernel = _HistogramBuilder->getGaussianKernel(regionSize, HistogramBuilder::REGION_SIGMA);
+        kernel = _GaussianKernels.insert(std::make_pair(key, gaussianKernel)).first;
+    }
+
+    std::vector<CellBlock> &blocks = _CellBlocks[key];
+    if (blocks.empty() && _weightSubdivisions > 0)
+    {
+        int divisionsX = std::min(_weightSubdivisions, regionSize.width);
+        int divisionsY = std::min(_weightSubdivisions, regionSize.height);
+
+        for (int j = 0; j < divisionsY; j++)
+        {
+            for (int i = 0; i < divisionsX; i++)
+            {
+                int x0 = i * regionSize.width / divisionsX, x1 = (i + 1) * regionSize.width / divisionsX;
+                int y0 = j * regionSize.height / divisionsY, y1 = (j + 1) * regionSize.height / divisionsY;
+
+                CellBlock block;
+                block.rect = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+                block.weight = cv::mean(kernel->second(block.rect))[0];
+                blocks.push_back(block);
+            }
+        }
+    }
+
+    return blocks;
+}
+
+void DenseDescriptorMap::addBlockHistogram(const cv::Rect &rect, double weight, double *histogram) const
+{
+    int binCount = _HistogramBuilder->getBinCount();
+    size_t stride = (size_t) (_PatternImage.cols + 1) * binCount;
+
+    const int *topLeft = &_Integral[rect.y * stride + (size_t) rect.x * binCount];
+    const int *topRight = topLeft + (size_t) rect.width * binCount;
+    const int *bottomLeft = topLeft + rect.height * stride;
+    const int *bottomRight = bottomLeft + (size_t) rect.width * binCount;
+
+    for (int bin = 0; bin < binCount; bin++)
+    {
+        histogram[bin] += weight * (bottomRight[bin] - topRight[bin] - bottomLeft[bin] + topLeft[bin]);
+    }
+}
+
+void DenseDescriptorMap::computeWindow(const cv::Rect &window, double *descriptor)
+{
+    CV_Assert(isBuilt());
+    CV_Assert((window & cv::Rect(0, 0, _imageSize.width, _imageSize.height)) == window);
+
+    int patchSize = _config.patchSize;
+    int stepSize = _config.stepSize;
+    CV_Assert(window.width >= patchSize && window.height >= patchSize);
+
+    // Patterns whose patches lie completely inside the window
+    int c0 = (window.x + stepSize - 1) / stepSize;
+    int r0 = (window.y + stepSize - 1) / stepSize;
+    int c1 = std::min((window.x + window.width - patchSize) / stepSize, _PatternImage.cols - 1);
+    int r1 = std::min((window.y + window.height - patchSize) / stepSize, _PatternImage.rows - 1);
+
+    cv::Size patternSize(c1 - c0 + 1, r1 - r0 + 1);
+    cv::Size gridSize = _HistogramBuilder->getGridSize();
+    cv::Size regionSize(patternSize.width / gridSize.width, patternSize.height / gridSize.height);
+    CV_Assert(regionSize.width > 0 && regionSize.height > 0);
+
+    const std::vector<CellBlock> &blocks = getCellBlocks(regionSize);
+    const cv::Mat &gaussianKernel = _GaussianKernels[std::make_pair(regionSize.width, regionSize.height)];
+
+    int binCount = _HistogramBuilder->getBinCount();
+    std::vector<cv::Rect> regions = _HistogramBuilder->getRegions(patternSize, gridSize,
+                                                                  _HistogramBuilder->isInsidePartitioningApplied());
+
+    for (int k = 0; k < regions.size(); k++)
+    {
+        cv::Rect region = regions[k] + cv::Point(c0, r0);
+
+        cv::Mat histogram(1, binCount, CV_64F, descriptor + (size_t) k * binCount);
+        histogram = cv::Scalar(0);
+
+        if (_weightSubdivisions == 0)
+        {
+            _HistogramBuilder->accumulate(_PatternImage(region), gaussianKernel, histogram.ptr<double>(0));
+        }
+        else
+        {
+            for (int b = 0; b < blocks.size(); b++)
+            {
+                addBlockHistogram(blocks[b].rect + region.tl(), blocks[b].weight, histogram.ptr<double>(0));
+            }
+        }
+
+        // Same normalization as HistogramBuilder, so exact weights reproduce its cells bit for bit
+        HistogramBuilder::normalizeCell(histogram.ptr<double>(0), binCount);
+    }
+}
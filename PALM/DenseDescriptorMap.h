@@ -0,0 +1,69 @@
+#ifndef PALM_DENSEDESCRIPTORMAP_H
+#define PALM_DENSEDESCRIPTORMAP_H
+
+#include <map>
+#include "PALM.h"
+
+
+namespace palm
+{
+    // Computes PALM descriptors for many windows of one large image. The pattern image is extracted once and turned
+    // into an integral histogram, so every cell histogram of a window is read with four lookups per bin.
+    //
+    // A window matches PALM::compute on the cropped image when its origin is a multiple of the step size and, for
+    // the approximated and sliding filters, which area-average the image by patchSize / 4, its width and height are
+    // multiples of patchSize / 4. Otherwise the last partial block is averaged differently in the crop.
+    // The Gaussian cell weighting is approximated by splitting every cell into weightSubdivisions x weightSubdivisions
+    // blocks that each carry the mean Gaussian weight of their pixels. weightSubdivisions = 0 accumulates the
+    // cell pixels with their exact weights instead, which reproduces PALM::compute at O(cell pixels) per cell.
+    //
+    // The integral histogram takes (rows + 1) x (cols + 1) x binCount ints for a rows x cols pattern image, e.g.
+    // 6.4 GB for a 20000 x 20000 image with step 8 and 256 bins. build() refuses images whose integral would exceed
+    // MAX_INTEGRAL_BYTES; split larger images into overlapping maps.
+    class DenseDescriptorMap
+    {
+    public:
+        DenseDescriptorMap(PALMConfig config, int weightSubdivisions = 4);
+        virtual ~DenseDescriptorMap() { };
+
+        static const long long MAX_INTEGRAL_BYTES = 1LL << 30;
+
+        int getWeightSubdivisions() const { return _weightSubdivisions; }
+        void setWeightSubdivisions(int weightSubdivisions);
+
+        int descriptorSize() const;
+        bool isBuilt() const { return !_PatternImage.empty(); }
+        cv::Size imageSize() const { return _imageSize; }
+        cv::Mat patternImage() const { return _PatternImage; }
+
+        virtual void build(const cv::Mat &image);
+        virtual cv::Mat compute(const cv::Rect &window);
+        virtual cv::Mat compute(const std::vector<cv::Rect> &windows);
+        virtual cv::Mat compute(cv::Size windowSize, cv::Size stride, std::vector<cv::Rect> &windows);
+
+    protected:
+        struct CellBlock
+        {
+            cv::Rect rect; // Relative to the cell origin
+            double weight;
+        };
+
+        const std::vector<CellBlock> &getCellBlocks(cv::Size regionSize);
+        void addBlockHistogram(const cv::Rect &rect, double weight, double *histogram) const;
+        void computeWindow(const cv::Rect &window, double *descriptor);
+
+    private:
+        PALMConfig _config;
+        int _weightSubdivisions;
+        cv::Ptr<PALM> _PALM;
+        cv::Ptr<HistogramBuilder> _HistogramBuilder;
+
+        cv::Size _imageSize;
+        cv::Mat _PatternImage;
+        std::vector<int> _Integral; // (rows + 1) x (cols + 1) x binCount bin counts
+        std::map<std::pair<int, int>, cv::Mat> _GaussianKernels;
+        std::map<std::pair<int, int>, std::vector<CellBlock>> _CellBlocks;
+    };
+}
+
+#endif //PALM_DENSEDESCRIPTORMAP_H
@@ -0,0 +1,358 @@
+#include "DescriptorArchive.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace palm;
+
+
+static const char ARCHIVE_MAGIC[8] = {'P', 'A', 'L', 'M', 'A', 'R', 'C', 'H'};
+static const int ARCHIVE_VERSION = 1;
+static const int HEADER_SIZE = sizeof(ARCHIVE_MAGIC) + 4 * sizeof(int);
+static const double QUANTIZATION_LEVELS = 65535.0;
+
+template<typename T>
+static void writeValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::istream &stream, T &value)
+{
+    return (bool) stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+static inline void writeVarint(std::vector<unsigned char> &buffer, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((unsigned char) value);
+}
+
+static inline unsigned int readVarint(const unsigned char *&data, const unsigned char *end)
+{
+    unsigned int value = 0;
+    for (int shift = 0; ; shift += 7)
+    {
+        CV_Assert(data < end && shift < 32);
+
+        unsigned char byte = *data++;
+        value |= (unsigned int) (byte & 0x7F) << shift;
+        if (byte < 0x80)
+        {
+            return value;
+        }
+    }
+}
+
+static inline unsigned int quantize(double value)
+{
+    CV_Assert(value >= 0);
+
+    return (unsigned int) cvRound(std::min(value, 1.0) * QUANTIZATION_LEVELS);
+}
+
+static void encodeDescriptor(const double *descriptor, int descriptorSize, int cellLength,
+                             std::vector<unsigned char> &buffer)
+{
+    for (int cell = 0; cell < descriptorSize; cell += cellLength)
+    {
+        const double *values = descriptor + cell;
+
+        unsigned int count = 0;
+        for (int bin = 0; bin < cellLength; bin++)
+        {
+            count += quantize(values[bin]) != 0;
+        }
+
+        writeVarint(buffer, count);
+
+        unsigned int run = 0;
+        for (int bin = 0; bin < cellLength; bin++)
+        {
+            unsigned int quantized = quantize(values[bin]);
+            if (quantized == 0)
+            {
+                run++;
+                continue;
+            }
+
+            writeVarint(buffer, run);
+            writeVarint(buffer, quantized);
+            run = 0;
+        }
+    }
+}
+
+static void decodeDescriptor(const unsigned char *&data, const unsigned char *end, int descriptorSize,
+                             int cellLength, double *descriptor)
+{
+    std::memset(descriptor, 0, sizeof(double) * descriptorSize);
+
+    for (int cell = 0; cell < descriptorSize; cell += cellLength)
+    {
+        unsigned int count = readVarint(data, end);
+        CV_Assert(count <= (unsigned int) cellLength);
+
+        // Runs are checked before they are added, so a corrupt archive cannot move the bin out of the cell
+        int bin = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            unsigned int run = readVarint(data, end);
+            CV_Assert(bin < cellLength && run < (unsigned int) (cellLength - bin));
+            bin += (int) run;
+
+            descriptor[cell + bin] = readVarint(data, end) / QUANTIZATION_LEVELS;
+            bin++;
+        }
+    }
+}
+
+
+DescriptorArchiveWriter::DescriptorArchiveWriter()
+        : _descriptorSize(0), _cellLength(0), _blockSize(0), _count(0), _offset(0)
+{
+
+}
+
+DescriptorArchiveWriter::~DescriptorArchiveWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+        // A destructor must not throw; the archive is left without a valid block index
+    }
+}
+
+void DescriptorArchiveWriter::open(const std::string &path, int descriptorSize, int cellLength, int blockSize)
+{
+    CV_Assert(!isOpen());
+    CV_Assert(cellLength > 0 && descriptorSize > 0 && descriptorSize % cellLength == 0 && blockSize > 0);
+
+    _Stream.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    CV_Assert(_Stream.is_open());
+
+    _descriptorSize = descriptorSize;
+    _cellLength = cellLength;
+    _blockSize = blockSize;
+    _count = 0;
+    _Block.clear();
+    _BlockOffsets.clear();
+
+    _Stream.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    writeValue<int>(_Stream, ARCHIVE_VERSION);
+    writeValue<int>(_Stream, descriptorSize);
+    writeValue<int>(_Stream, cellLength);
+    writeValue<int>(_Stream, blockSize);
+
+    _offset = HEADER_SIZE;
+}
+
+void DescriptorArchiveWriter::close()
+{
+    if (!_Stream.is_open())
+    {
+        return;
+    }
+
+    if (_count % _blockSize != 0)
+    {
+        writeBlock();
+    }
+
+    // Block index: descriptor count, block count, the block offsets and the end of the last block. The trailer
+    // holds the index offset.
+    long long indexOffset = _offset;
+
+    writeValue<long long>(_Stream, _count);
+    writeValue<int>(_Stream, (int) _BlockOffsets.size());
+    for (size_t b = 0; b < _BlockOffsets.size(); b++)
+    {
+        writeValue<long long>(_Stream, _BlockOffsets[b]);
+    }
+    writeValue<long long>(_Stream, indexOffset);
+
+    writeValue<long long>(_Stream, indexOffset);
+    _Stream.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+
+    _Stream.close();
+}
+
+void DescriptorArchiveWriter::write(const cv::Mat &descriptors)
+{
+    CV_Assert(isOpen());
+    CV_Assert(descriptors.type() == CV_64F && descriptors.cols == _descriptorSize);
+
+    for (int i = 0; i < descriptors.rows; i++)
+    {
+        encodeDescriptor(descriptors.ptr<double>(i), _descriptorSize, _cellLength, _Block);
+
+        if (++_count % _blockSize == 0)
+        {
+            writeBlock();
+        }
+    }
+}
+
+void DescriptorArchiveWriter::writeBlock()
+{
+    _BlockOffsets.push_back(_offset);
+
+    _Stream.write(reinterpret_cast<const char *>(_Block.data()), _Block.size());
+    CV_Assert(_Stream.good());
+
+    _offset += (long long) _Block.size();
+    _Block.clear();
+}
+
+
+DescriptorArchiveReader::DescriptorArchiveReader()
+        : _descriptorSize(0), _cellLength(0), _blockSize(0), _count(0), _cachedBlock(-1)
+{
+
+}
+
+void DescriptorArchiveReader::open(const std::string &path)
+{
+    CV_Assert(!isOpen());
+
+    _Stream.open(path.c_str(), std::ios::binary);
+    CV_Assert(_Stream.is_open());
+
+    char magic[sizeof(ARCHIVE_MAGIC)];
+    int version;
+
+    bool valid = (bool) _Stream.read(magic, sizeof(magic)) && std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0 &&
+                 readValue<int>(_Stream, version) && version == ARCHIVE_VERSION &&
+                 readValue<int>(_Stream, _descriptorSize) &&
+                 readValue<int>(_Stream, _cellLength) &&
+                 readValue<int>(_Stream, _blockSize);
+    CV_Assert(valid && _descriptorSize > 0 && _cellLength > 0 && _descriptorSize % _cellLength == 0 &&
+              _blockSize > 0);
+
+    // The trailer holds the index offset and a closing magic, which is missing if the archive was not closed
+    long long indexOffset;
+    _Stream.seekg(-(std::streamoff) (sizeof(long long) + sizeof(ARCHIVE_MAGIC)), std::ios::end);
+    valid = readValue<long long>(_Stream, indexOffset) &&
+            _Stream.read(magic, sizeof(magic)) && std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+    CV_Assert(valid);
+
+    // Every block holds at least one byte, which bounds the block count before the index is allocated
+    int blockCount;
+    _Stream.seekg(indexOffset);
+    valid = indexOffset >= HEADER_SIZE && readValue<long long>(_Stream, _count) &&
+            readValue<int>(_Stream, blockCount) && blockCount >= 0 && blockCount <= indexOffset - HEADER_SIZE;
+    CV_Assert(valid);
+
+    // Every block but the last is full, so read() finds the block of any index below the count
+    CV_Assert(_count >= 0 && _count <= (long long) blockCount * _blockSize);
+    CV_Assert(blockCount == 0 || _count > (long long) (blockCount - 1) * _blockSize);
+
+    _BlockOffsets.resize((size_t) blockCount + 1);
+    _Stream.read(reinterpret_cast<char *>(_BlockOffsets.data()), sizeof(long long) * _BlockOffsets.size());
+    CV_Assert(_Stream.good());
+
+    for (int b = 0; b < blockCount; b++)
+    {
+        CV_Assert(_BlockOffsets[b] >= HEADER_SIZE && _BlockOffsets[b] < _BlockOffsets[b + 1]);
+    }
+    CV_Assert(_BlockOffsets[blockCount] <= indexOffset);
+
+    _cachedBlock = -1;
+    _CachedBlock.release();
+}
+
+void DescriptorArchiveReader::close()
+{
+    if (_Stream.is_open())
+    {
+        _Stream.close();
+    }
+
+    _BlockOffsets.clear();
+    _cachedBlock = -1;
+    _CachedBlock.release();
+}
+
+cv::Mat DescriptorArchiveReader::read(long long index)
+{
+    CV_Assert(isOpen());
+    CV_Assert(index >= 0 && index < _count);
+
+    int block = (int) (index / _blockSize);
+    if (block != _cachedBlock)
+    {
+        decodeBlock(block, _CachedBlock);
+        _cachedBlock = block;
+    }
+
+    return _CachedBlock.row((int) (index % _blockSize)).clone();
+}
+
+cv::Mat DescriptorArchiveReader::readBlock(int block)
+{
+    CV_Assert(isOpen());
+    CV_Assert(block >= 0 && block < blockCount());
+
+    cv::Mat descriptors;
+    decodeBlock(block, descriptors);
+
+    return descriptors;
+}
+
+void DescriptorArchiveReader::readBlock(int block, cv::Mat &descriptors)
+{
+    CV_Assert(isOpen());
+    CV_Assert(block >= 0 && block < blockCount());
+
+    decodeBlock(block, descriptors);
+}
+
+cv::Mat DescriptorArchiveReader::readAll()
+{
+    CV_Assert(isOpen());
+
+    cv::Mat descriptors((int) _count, _descriptorSize, CV_64F);
+    for (int b = 0; b < blockCount(); b++)
+    {
+        int first = b * _blockSize;
+        cv::Mat block = descriptors.rowRange(first, (int) std::min<long long>(first + _blockSize, _count));
+        decodeBlock(b, block);
+    }
+
+    return descriptors;
+}
+
+void DescriptorArchiveReader::decodeBlock(int block, cv::Mat &descriptors)
+{
+    long long first = (long long) block * _blockSize;
+    int count = (int) std::min<long long>(_blockSize, _count - first);
+
+    // Blocks of readAll() are views into the result and are decoded in place
+    if (descriptors.rows != count || descriptors.cols != _descriptorSize || descriptors.type() != CV_64F)
+    {
+        descriptors.create(count, _descriptorSize, CV_64F);
+    }
+
+    size_t length = (size_t) (_BlockOffsets[block + 1] - _BlockOffsets[block]);
+    _Buffer.resize(length);
+
+    _Stream.clear();
+    _Stream.seekg(_BlockOffsets[block]);
+    _Stream.read(reinterpret_cast<char *>(_Buffer.data()), length);
+    CV_Assert(_Stream.good());
+
+    const unsigned char *data = _Buffer.data();
+    const unsigned char *end = data + length;
+    for (int i = 0; i < count; i++)
+    {
+        decodeDescriptor(data, end, _descriptorSize, _cellLength, descriptors.ptr<double>(i));
+    }
+    CV_Assert(data == end);
+}
@@ -0,0 +1,81 @@
+#ifndef PALM_DESCRIPTORARCHIVE_H
+#define PALM_DESCRIPTORARCHIVE_H
+
+#include <fstream>
+#include <opencv2/core.hpp>
+
+
+namespace palm
+{
+    // Compressed archive of PALM descriptors. Descriptors are grouped into blocks of a fixed number of descriptors.
+    // Within a block, every histogram cell is stored as its non-zero bin count followed by (zero run, value) pairs.
+    // Values are quantized to 16 bits and all integers are varint coded. A block index at the end of the file
+    // locates any block in O(1), so descriptor i is found by decoding a single block.
+    //
+    // Histogram values must be non-negative and at most 1, which holds for the L2 normalized PALM cells. The
+    // quantization error is at most 1 / 131070 per bin.
+    class DescriptorArchiveWriter
+    {
+    public:
+        DescriptorArchiveWriter();
+        virtual ~DescriptorArchiveWriter(); // Closes the archive but cannot report errors, call close() for them
+
+        void open(const std::string &path, int descriptorSize, int cellLength, int blockSize = 64);
+        void close(); // Writes the last block and the block index
+        bool isOpen() const { return _Stream.is_open(); }
+
+        long long size() const { return _count; }
+        void write(const cv::Mat &descriptors); // One descriptor per row
+
+    private:
+        void writeBlock();
+
+        std::ofstream _Stream;
+        int _descriptorSize;
+        int _cellLength;
+        int _blockSize;
+        long long _count;
+        long long _offset;
+        std::vector<unsigned char> _Block;
+        std::vector<long long> _BlockOffsets;
+    };
+
+
+    class DescriptorArchiveReader
+    {
+    public:
+        DescriptorArchiveReader();
+        virtual ~DescriptorArchiveReader() { };
+
+        void open(const std::string &path);
+        void close();
+        bool isOpen() const { return _Stream.is_open(); }
+
+        int descriptorSize() const { return _descriptorSize; }
+        int cellLength() const { return _cellLength; }
+        int blockSize() const { return _blockSize; }
+        int blockCount() const { return (int) _BlockOffsets.size() - 1; }
+        long long size() const { return _count; }
+
+        cv::Mat read(long long index);
+        cv::Mat readBlock(int block); // Descriptors of the block, one per row, for streaming scans
+        void readBlock(int block, cv::Mat &descriptors); // Reuses the memory of descriptors between blocks
+        cv::Mat readAll();
+
+    private:
+        void decodeBlock(int block, cv::Mat &descriptors);
+
+        std::ifstream _Stream;
+        int _descriptorSize;
+        int _cellLength;
+        int _blockSize;
+        long long _count;
+        std::vector<long long> _BlockOffsets;
+        std::vector<unsigned char> _Buffer;
+
+        int _cachedBlock;
+        cv::Mat _CachedBlock;
+    };
+}
+
+#endif //PALM_DESCRIPTORARCHIVE_H
@@ -0,0 +1,249 @@
+#include "DescriptorFile.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace palm;
+
+
+static const char FILE_MAGIC[8] = {'P', 'A', 'L', 'M', 'D', 'E', 'S', 'C'};
+static const int FILE_VERSION = 2;
+static const int MAX_PATH_LENGTH = 1 << 16;
+
+template<typename T>
+static void writeValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::istream &stream, T &value)
+{
+    return (bool) stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+static bool sameConfig(const PALMConfig &config1, const PALMConfig &config2)
+{
+    return config1.patchSize == config2.patchSize &&
+           config1.gridSize == config2.gridSize &&
+           config1.stepSize == config2.stepSize &&
+           config1.momentOrder == config2.momentOrder &&
+           config1.filterType == config2.filterType &&
+           config1.applyInsidePartitioning == config2.applyInsidePartitioning &&
+           config1.codeGroupBits == config2.codeGroupBits;
+}
+
+static bool truncateFile(const std::string &path, std::streamoff size)
+{
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    bool truncated = _chsize_s(fd, size) == 0;
+    _close(fd);
+
+    return truncated;
+#else
+    return ::truncate(path.c_str(), (off_t) size) == 0;
+#endif
+}
+
+
+DescriptorFileWriter::DescriptorFileWriter()
+        : _descriptorSize(0), _lastIndex(-1)
+{
+
+}
+
+DescriptorFileWriter::~DescriptorFileWriter()
+{
+    close();
+}
+
+long long DescriptorFileWriter::open(const std::string &path, const PALMConfig &config, int descriptorSize, bool resume)
+{
+    CV_Assert(!isOpen());
+    CV_Assert(descriptorSize > 0);
+
+    _descriptorSize = descriptorSize;
+    _lastIndex = -1;
+    _LastPath.clear();
+
+    long long count = 0;
+
+    std::ifstream existing(path.c_str(), std::ios::binary);
+    if (resume && existing.good())
+    {
+        existing.close();
+
+        DescriptorFileReader reader;
+        reader.open(path);
+        CV_Assert(reader.descriptorSize() == descriptorSize && sameConfig(reader.config(), config));
+
+        // Keep every complete record and cut off a record that was only partially written
+        std::streamoff validEnd = reader.position();
+        DescriptorRecord record;
+        while (reader.read(record))
+        {
+            count++;
+            _lastIndex = record.index;
+            _LastPath = record.path;
+            validEnd = reader.position();
+        }
+        reader.close();
+
+        CV_Assert(truncateFile(path, validEnd));
+
+        _Stream.open(path.c_str(), std::ios::binary | std::ios::app);
+        CV_Assert(_Stream.is_open());
+    }
+    else
+    {
+        existing.close();
+
+        _Stream.open(path.c_str(), std::ios::binary | std::ios::trunc);
+        CV_Assert(_Stream.is_open());
+
+        _Stream.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        writeValue<int>(_Stream, FILE_VERSION);
+        writeValue<int>(_Stream, descriptorSize);
+        writeValue<int>(_Stream, config.patchSize);
+        writeValue<int>(_Stream, config.gridSize);
+        writeValue<int>(_Stream, config.stepSize);
+        writeValue<int>(_Stream, config.momentOrder);
+        writeValue<int>(_Stream, (int) config.filterType);
+        writeValue<int>(_Stream, config.applyInsidePartitioning ? 1 : 0);
+        writeValue<int>(_Stream, config.codeGroupBits);
+        _Stream.flush();
+    }
+
+    return count;
+}
+
+void DescriptorFileWriter::close()
+{
+    if (_Stream.is_open())
+    {
+        _Stream.close();
+    }
+}
+
+void DescriptorFileWriter::write(const DescriptorRecord &record)
+{
+    CV_Assert(isOpen());
+    CV_Assert(record.index > _lastIndex);
+    CV_Assert(record.path.size() < (size_t) MAX_PATH_LENGTH);
+    CV_Assert(record.descriptor.type() == CV_64F && record.descriptor.rows == 1 &&
+              record.descriptor.cols == _descriptorSize);
+
+    writeValue<long long>(_Stream, record.index);
+    writeValue<int>(_Stream, (int) record.path.size());
+    _Stream.write(record.path.data(), record.path.size());
+    _Stream.write(reinterpret_cast<const char *>(record.descriptor.ptr<double>(0)), sizeof(double) * _descriptorSize);
+
+    CV_Assert(_Stream.good());
+
+    _lastIndex = record.index;
+    _LastPath = record.path;
+}
+
+void DescriptorFileWriter::flush()
+{
+    CV_Assert(isOpen());
+
+    _Stream.flush();
+}
+
+
+DescriptorFileReader::DescriptorFileReader()
+        : _descriptorSize(0)
+{
+
+}
+
+void DescriptorFileReader::open(const std::string &path)
+{
+    CV_Assert(!isOpen());
+
+    _Stream.open(path.c_str(), std::ios::binary);
+    CV_Assert(_Stream.is_open());
+
+    char magic[sizeof(FILE_MAGIC)];
+    int version, filterType, applyInsidePartitioning;
+
+    if (!_Stream.read(magic, sizeof(magic)) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 ||
+        !readValue<int>(_Stream, version))
+    {
+        _Stream.close();
+        CV_Error(cv::Error::StsParseError, "Not a PALM descriptor file");
+    }
+    if (version < 1 || version > FILE_VERSION)
+    {
+        _Stream.close();
+        CV_Error(cv::Error::StsUnsupportedFormat, "Unsupported PALM descriptor file version");
+    }
+
+    // Version 1 has no code groups; its configurations have at most 8 filters, a single group of the default size
+    _config.codeGroupBits = PALMConfig().codeGroupBits;
+
+    bool valid = readValue<int>(_Stream, _descriptorSize) && _descriptorSize > 0 &&
+                 readValue<int>(_Stream, _config.patchSize) &&
+                 readValue<int>(_Stream, _config.gridSize) &&
+                 readValue<int>(_Stream, _config.stepSize) &&
+                 readValue<int>(_Stream, _config.momentOrder) &&
+                 readValue<int>(_Stream, filterType) &&
+                 readValue<int>(_Stream, applyInsidePartitioning) &&
+                 (version < 2 || readValue<int>(_Stream, _config.codeGroupBits));
+    if (!valid)
+    {
+        _Stream.close();
+        CV_Error(cv::Error::StsParseError, "Truncated PALM descriptor file header");
+    }
+
+    _config.filterType = (FilterType) filterType;
+    _config.applyInsidePartitioning = applyInsidePartitioning != 0;
+}
+
+void DescriptorFileReader::close()
+{
+    if (_Stream.is_open())
+    {
+        _Stream.close();
+    }
+}
+
+bool DescriptorFileReader::read(DescriptorRecord &record)
+{
+    CV_Assert(isOpen());
+
+    long long index;
+    int pathLength;
+    if (!readValue<long long>(_Stream, index) || !readValue<int>(_Stream, pathLength) ||
+        pathLength < 0 || pathLength >= MAX_PATH_LENGTH)
+    {
+        return false;
+    }
+
+    std::string path((size_t) pathLength, '\0');
+    cv::Mat descriptor(1, _descriptorSize, CV_64F);
+
+    if (!_Stream.read(&path[0], pathLength) ||
+        !_Stream.read(reinterpret_cast<char *>(descriptor.ptr<double>(0)), sizeof(double) * _descriptorSize))
+    {
+        return false;
+    }
+
+    record.index = index;
+    record.path = path;
+    record.descriptor = descriptor;
+
+    return true;
+}
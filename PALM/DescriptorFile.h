@@ -0,0 +1,74 @@
+#ifndef PALM_DESCRIPTORFILE_H
+#define PALM_DESCRIPTORFILE_H
+
+#include <fstream>
+#include "PALM.h"
+
+
+namespace palm
+{
+    // Binary descriptor file: a header with the PALM configuration followed by one record per image holding its
+    // position in the input list, its path and its descriptor. Records are appended in input order, so an
+    // interrupted run can be resumed after the last complete record.
+    class DescriptorRecord
+    {
+    public:
+        DescriptorRecord() : index(-1) { }
+
+        long long index;
+        std::string path;
+        cv::Mat descriptor;
+    };
+
+
+    class DescriptorFileWriter
+    {
+    public:
+        DescriptorFileWriter();
+        virtual ~DescriptorFileWriter();
+
+        // Opens a new file, or with resume = true reopens an existing one after its last complete record.
+        // Returns the number of complete records that are already in the file.
+        long long open(const std::string &path, const PALMConfig &config, int descriptorSize, bool resume = false);
+        void close();
+        bool isOpen() const { return _Stream.is_open(); }
+
+        long long lastIndex() const { return _lastIndex; }
+        std::string lastPath() const { return _LastPath; } // Path of the last record, to check a resumed input list
+        void write(const DescriptorRecord &record);
+        void flush();
+
+    private:
+        std::ofstream _Stream;
+        int _descriptorSize;
+        long long _lastIndex;
+        std::string _LastPath;
+    };
+
+
+    class DescriptorFileReader
+    {
+    public:
+        DescriptorFileReader();
+        virtual ~DescriptorFileReader() { };
+
+        // Reads files of every version up to the current one; throws and stays closed on any other file
+        void open(const std::string &path);
+        void close();
+        bool isOpen() const { return _Stream.is_open(); }
+
+        PALMConfig config() const { return _config; }
+        int descriptorSize() const { return _descriptorSize; }
+
+        // Reads the next complete record; returns false at the end of the file or at a truncated record
+        bool read(DescriptorRecord &record);
+        std::streamoff position() { return _Stream.tellg(); }
+
+    private:
+        std::ifstream _Stream;
+        PALMConfig _config;
+        int _descriptorSize;
+    };
+}
+
+#endif //PALM_DESCRIPTORFILE_H
@@ -1,4 +1,5 @@
 #include "HistogramBuilder.h"
+#include "Kernels.h"
 
 using namespace palm;
 
@@ -10,6 +11,13 @@ HistogramBuilder::HistogramBuilder(cv::Size gridSize, int binCount, bool applyIn
     setApplyInsidePartitioning(applyInsidePartitioning);
 }
 
+HistogramBuilder::HistogramBuilder(cv::Size gridSize, int codeBits, int groupBits, bool applyInsidePartitioning)
+{
+    setGridSize(gridSize);
+    setCodeGroups(codeBits, groupBits);
+    setApplyInsidePartitioning(applyInsidePartitioning);
+}
+
 void HistogramBuilder::setGridSize(cv::Size gridSize)
 {
     CV_Assert(gridSize.height > 0 && gridSize.width > 0);
@@ -24,14 +32,38 @@ void HistogramBuilder::setApplyInsidePartitioning(bool applyInsidePartitioning)
 
 void HistogramBuilder::setBinCount(int binCount)
 {
-    CV_Assert(binCount > 1);
+    CV_Assert(binCount > 1 && binCount <= (1 << 16));
 
+    // A single group, every code is a bin
     _binCount = binCount;
+    _codeBits = 1;
+    while ((1 << _codeBits) < binCount)
+    {
+        _codeBits++;
+    }
+    _groupBits = _codeBits;
+}
+
+void HistogramBuilder::setCodeGroups(int codeBits, int groupBits)
+{
+    CV_Assert(codeBits > 0 && codeBits <= 16 && groupBits > 0);
+
+    _codeBits = codeBits;
+    _groupBits = std::min(groupBits, codeBits);
+
+    // Every group is full except maybe the last one, which gets the remaining high bits
+    int lastGroupBits = codeBits - (groupCount() - 1) * _groupBits;
+    _binCount = ((groupCount() - 1) << _groupBits) + (1 << lastGroupBits);
 }
 
-cv::Mat HistogramBuilder::build(const cv::Mat &image)
+cv::Mat HistogramBuilder::build(const cv::Mat &image, const cv::Mat &mask)
 {
-    return compute(image, getGridSize(), getBinCount(), isInsidePartitioningApplied());
+    return compute(image, mask, getGridSize(), getBinCount(), isInsidePartitioningApplied());
+}
+
+SparseHistogram HistogramBuilder::buildSparse(const cv::Mat &image, const cv::Mat &mask)
+{
+    return computeSparse(image, mask, getGridSize(), getBinCount(), isInsidePartitioningApplied());
 }
 
 cv::Mat HistogramBuilder::getGaussianKernel(cv::Size size, double sigma) const
@@ -51,24 +83,97 @@ cv::Mat HistogramBuilder::getGaussianKernel(cv::Size size, double sigma) const
     return kernel;
 }
 
-cv::Mat HistogramBuilder::getRegionHistogram(const cv::Mat &region, int binCount, const cv::Mat &gaussianKernel)
+std::vector<cv::Rect> HistogramBuilder::getRegions(cv::Size imageSize, cv::Size gridSize, bool applySlidedGrid) const
 {
-    cv::Mat histogram = cv::Mat::zeros(1, binCount, CV_64F);
+    cv::Size regionSize = cv::Size(imageSize.width / gridSize.width, imageSize.height / gridSize.height);
 
-    for (int i = 0; i < region.rows; i++)
+    // Regions are listed in the order their histograms appear in the descriptor
+    std::vector<cv::Rect> regions;
+    for (int j = 0; j < gridSize.height; j++)
     {
-        for (int j = 0; j < region.cols; j++)
+        for (int i = 0; i < gridSize.width; i++)
         {
-            int bin = region.at<uchar>(i, j);
-            histogram.at<double>(0, bin) += gaussianKernel.at<double>(i, j);
+            regions.push_back(cv::Rect(i * regionSize.width, j * regionSize.height,
+                                       regionSize.width, regionSize.height));
         }
     }
 
-    histogram = histogram / (cv::norm(histogram, cv::NORM_L2) + std::numeric_limits<double>::epsilon());
+    if (applySlidedGrid)
+    {
+        for (int j = 0; j < gridSize.height - 1; j++)
+        {
+            for (int i = 0; i < gridSize.width - 1; i++)
+            {
+                regions.push_back(cv::Rect(i * regionSize.width + regionSize.width / 2,
+                                           j * regionSize.height + regionSize.height / 2,
+                                           regionSize.width, regionSize.height));
+            }
+        }
+    }
+
+    return regions;
+}
+
+void HistogramBuilder::accumulate(const cv::Mat &codes, const cv::Mat &weights, double *histogram,
+                                  const cv::Mat &mask) const
+{
+    CV_Assert((codes.type() == CV_8U || codes.type() == CV_16U) && codes.size() == weights.size());
+    CV_Assert(weights.type() == CV_64F);
+    CV_Assert(mask.empty() || (mask.type() == CV_8U && mask.size() == codes.size()));
+
+    const KernelTable &kernel = kernels();
+    int groups = groupCount();
+
+    const uchar *valid = mask.empty() ? nullptr : mask.ptr<uchar>(0);
+    size_t validStride = mask.empty() ? 0 : mask.step1();
+
+    if (codes.type() == CV_8U && groups == 1)
+    {
+        kernel.accumulateHistogram(codes.ptr<uchar>(0), codes.step1(), weights.ptr<double>(0), weights.step1(),
+                                   valid, validStride, codes.rows, codes.cols, histogram);
+    }
+    else if (codes.type() == CV_8U)
+    {
+        kernel.accumulateGroupedHistogram(codes.ptr<uchar>(0), codes.step1(), weights.ptr<double>(0),
+                                          weights.step1(), valid, validStride, codes.rows, codes.cols, _groupBits,
+                                          groups, histogram);
+    }
+    else
+    {
+        kernel.accumulateGroupedHistogram16(codes.ptr<ushort>(0), codes.step1(), weights.ptr<double>(0),
+                                            weights.step1(), valid, validStride, codes.rows, codes.cols, _groupBits,
+                                            groups, histogram);
+    }
+}
+
+cv::Mat HistogramBuilder::getRegionHistogram(const cv::Mat &region, const cv::Mat &regionMask, int binCount,
+                                             const cv::Mat &gaussianKernel)
+{
+    cv::Mat histogram = cv::Mat::zeros(1, binCount, CV_64F);
+
+    // A cell without any unmasked pixel stays zero
+    accumulate(region, gaussianKernel, histogram.ptr<double>(0), regionMask);
+
+    normalizeCell(histogram.ptr<double>(0), binCount);
 
     return histogram;
 }
 
+void HistogramBuilder::normalizeCell(double *values, int count)
+{
+    double squares = 0;
+    for (int i = 0; i < count; i++)
+    {
+        squares += values[i] * values[i];
+    }
+
+    double scale = 1.0 / (std::sqrt(squares) + std::numeric_limits<double>::epsilon());
+    for (int i = 0; i < count; i++)
+    {
+        values[i] *= scale;
+    }
+}
+
 int HistogramBuilder::histogramLength()
 {
     cv::Size gridSize = getGridSize();
@@ -83,59 +188,77 @@ int HistogramBuilder::histogramLength()
     return length;
 }
 
-cv::Mat HistogramBuilder::compute(const cv::Mat &image, cv::Size gridSize, int binCount, bool applySlidedGrid)
+cv::Mat HistogramBuilder::compute(const cv::Mat &image, const cv::Mat &mask, cv::Size gridSize, int binCount,
+                                  bool applySlidedGrid)
 {
     CV_Assert(!image.empty() && image.rows > 0 && image.cols > 0);
     CV_Assert(gridSize.width > 0 && gridSize.height > 0);
+    CV_Assert(mask.empty() || mask.size() == image.size());
 
     cv::Size regionSize = cv::Size(image.cols / gridSize.width, image.rows / gridSize.height);
-    cv::Mat gaussianKernel = getGaussianKernel(regionSize, 8);
+    cv::Mat gaussianKernel = getGaussianKernel(regionSize, REGION_SIGMA);
 
     int descriptorSize = histogramLength();
     cv::Mat histogram(1, descriptorSize, CV_64F);
 
-    // Compute the histograms for the complete grid
-    for (int i = 0; i < gridSize.width; i++)
+    // Compute the histograms for the complete grid followed by the slided grid
+    std::vector<cv::Rect> regions = getRegions(image.size(), gridSize, applySlidedGrid);
+    for (int k = 0; k < regions.size(); k++)
     {
-        for (int j = 0; j < gridSize.height; j++)
-        {
-            cv::Rect roi = cv::Rect(i * regionSize.width, j * regionSize.height, regionSize.width, regionSize.height);
-            cv::Mat region = image(roi);
+        cv::Mat region = image(regions[k]);
+        cv::Mat regionMask = mask.empty() ? cv::Mat() : mask(regions[k]);
 
-            cv::Mat regionHistogram = getRegionHistogram(region, binCount, gaussianKernel);
+        cv::Mat regionHistogram = getRegionHistogram(region, regionMask, binCount, gaussianKernel);
 
-            cv::Rect targetLocation = cv::Rect(binCount * (j * gridSize.width + i), 0, binCount, 1);
-            cv::Mat targetRegion = histogram(targetLocation);
-            regionHistogram.copyTo(targetRegion);
-        }
+        cv::Rect targetLocation = cv::Rect(binCount * k, 0, binCount, 1);
+        cv::Mat targetRegion = histogram(targetLocation);
+        regionHistogram.copyTo(targetRegion);
     }
 
-    if (applySlidedGrid)
-    {
-        // Compute the histograms for the slided grid
+    return histogram;
+}
 
-        int numRegionsX = gridSize.width - 1;
-        int numRegionsY = gridSize.height - 1;
-        int numRegions = gridSize.width * gridSize.height;
+SparseHistogram HistogramBuilder::computeSparse(const cv::Mat &image, const cv::Mat &mask, cv::Size gridSize,
+                                                int binCount, bool applySlidedGrid)
+{
+    CV_Assert(!image.empty() && image.rows > 0 && image.cols > 0);
+    CV_Assert(gridSize.width > 0 && gridSize.height > 0);
+    CV_Assert(mask.empty() || mask.size() == image.size());
 
-        for (uint i = 0; i < numRegionsX; i++)
-        {
-            for (uint j = 0; j < numRegionsY; j++)
-            {
-                cv::Range rowRange = cv::Range(j * regionSize.height + regionSize.height / 2,
-                                               (j + 1) * regionSize.height + regionSize.height / 2);
-                cv::Range colRange = cv::Range(i * regionSize.width + regionSize.width / 2,
-                                               (i + 1) * regionSize.width + regionSize.width / 2);
-                cv::Mat region = image(rowRange, colRange).clone();
+    cv::Size regionSize = cv::Size(image.cols / gridSize.width, image.rows / gridSize.height);
+    cv::Mat gaussianKernel = getGaussianKernel(regionSize, REGION_SIGMA);
 
-                cv::Mat regionHistogram = getRegionHistogram(region, binCount, gaussianKernel);
+    SparseHistogram histogram(binCount);
 
-                cv::Rect targetLocation = cv::Rect(binCount * (numRegions + j * numRegionsX + i), 0, binCount, 1);
-                cv::Mat targetRegion = histogram(targetLocation);
-                regionHistogram.copyTo(targetRegion);
+    // Accumulate each region into a scratch histogram and only emit its populated bins, which come out sorted
+    cv::Mat scratch = cv::Mat::zeros(1, binCount, CV_64F);
+    double *bins = scratch.ptr<double>(0);
+    std::vector<int> populated;
+    std::vector<double> values;
+
+    std::vector<cv::Rect> regions = getRegions(image.size(), gridSize, applySlidedGrid);
+    for (int k = 0; k < regions.size(); k++)
+    {
+        cv::Mat region = image(regions[k]);
+        accumulate(region, gaussianKernel, bins, mask.empty() ? cv::Mat() : mask(regions[k]));
+
+        populated.clear();
+        values.clear();
+        for (int bin = 0; bin < binCount; bin++)
+        {
+            if (bins[bin] != 0)
+            {
+                populated.push_back(bin);
+                values.push_back(bins[bin]);
+                bins[bin] = 0;
             }
         }
+
+        // Same normalization as the dense histogram, the zero bins left out do not change it
+        normalizeCell(values.data(), (int) values.size());
+
+        histogram.appendCell(populated.data(), values.data(), (int) populated.size());
     }
 
     return histogram;
-}
\ No newline at end of file
+}
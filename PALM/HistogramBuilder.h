@@ -3,37 +3,64 @@
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include "SparseHistogram.h"
 
 
 namespace palm
 {
+    // Builds the cell histograms of a pattern image. A cell holds one bin per pattern code, or, when the codes are
+    // split into groups of bits, one sub-histogram per group so that long codes keep the histogram size bounded.
     class HistogramBuilder
     {
     public:
         HistogramBuilder(cv::Size gridSize, int binCount, bool applyInsidePartitioning);
+        HistogramBuilder(cv::Size gridSize, int codeBits, int groupBits, bool applyInsidePartitioning);
         virtual ~HistogramBuilder() { };
 
+        static const int REGION_SIGMA = 8;
+
         cv::Size getGridSize() const { return _gridSize; }
         void setGridSize(cv::Size gridSize);
 
         bool isInsidePartitioningApplied() const { return _applyInsidePartitioning; }
         void setApplyInsidePartitioning(bool applyInsidePartitioning);
 
-        int getBinCount() const { return _binCount; }
+        int getBinCount() const { return _binCount; } // Bins of a cell, summed over all groups
         void setBinCount(int binCount);
 
+        int getCodeBits() const { return _codeBits; }
+        int getGroupBits() const { return _groupBits; }
+        int groupCount() const { return (_codeBits + _groupBits - 1) / _groupBits; }
+        void setCodeGroups(int codeBits, int groupBits);
+
         virtual int histogramLength();
-        virtual cv::Mat build(const cv::Mat &image);
+        // Pattern pixels with a zero mask entry are left out of their cell histograms
+        virtual cv::Mat build(const cv::Mat &image, const cv::Mat &mask = cv::Mat());
+        virtual SparseHistogram buildSparse(const cv::Mat &image, const cv::Mat &mask = cv::Mat());
 
-    protected:
         cv::Mat getGaussianKernel(cv::Size size, double sigma) const;
-        cv::Mat getRegionHistogram(const cv::Mat &region, int binCount, const cv::Mat &gaussianKernel);
-        cv::Mat compute(const cv::Mat &image, cv::Size gridSize, int binCount, bool applySlidedGrid);
+        std::vector<cv::Rect> getRegions(cv::Size imageSize, cv::Size gridSize, bool applySlidedGrid) const;
+        void accumulate(const cv::Mat &codes, const cv::Mat &weights, double *histogram,
+                        const cv::Mat &mask = cv::Mat()) const;
+
+        // L2 normalizes a cell histogram in place: the squares are summed in bin order and the bins are multiplied by
+        // the reciprocal of norm + epsilon. Zero bins may be left out, so the dense and sparse forms stay identical.
+        static void normalizeCell(double *values, int count);
+
+    protected:
+        cv::Mat getRegionHistogram(const cv::Mat &region, const cv::Mat &regionMask, int binCount,
+                                   const cv::Mat &gaussianKernel);
+        cv::Mat compute(const cv::Mat &image, const cv::Mat &mask, cv::Size gridSize, int binCount,
+                        bool applySlidedGrid);
+        SparseHistogram computeSparse(const cv::Mat &image, const cv::Mat &mask, cv::Size gridSize, int binCount,
+                                      bool applySlidedGrid);
 
     private:
         cv::Size _gridSize;
         bool _applyInsidePartitioning;
         int _binCount;
+        int _codeBits;
+        int _groupBits;
     };
 }
 
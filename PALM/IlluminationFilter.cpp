@@ -1,9 +1,15 @@
 #include "IlluminationFilter.h"
+#include "Kernels.h"
 
 palm::IlluminationFilter::IlluminationFilter(double alpha, int returnType)
 {
     setAlpha(alpha);
     setReturnType(returnType);
+
+    for (int v = 0; v < 256; v++)
+    {
+        _logTable[v] = std::log(v / 255.0);
+    }
 }
 
 void palm::IlluminationFilter::setAlpha(double alpha)
@@ -25,27 +31,19 @@ cv::Mat palm::IlluminationFilter::apply(const cv::Mat &image)
     CV_Assert(!image.empty() && image.type() == CV_8UC3);
 
     cv::Mat out = cv::Mat::zeros(image.rows, image.cols, _returnType);
+
+    const KernelTable &kernel = kernels();
     for (int i = 0; i < out.rows; i++)
     {
-        for (int j = 0; j < out.cols; j++)
+        const uchar *bgr = image.ptr<uchar>(i);
+
+        if (_returnType == CV_8U)
+        {
+            kernel.illumination(bgr, out.cols, _logTable, _alpha, nullptr, out.ptr<uchar>(i));
+        }
+        else if (_returnType == CV_64F)
         {
-            cv::Vec3b value = image.at<cv::Vec3b>(i, j);
-            double b = value.val[0] / 255.0;
-            double g = value.val[1] / 255.0;
-            double r = value.val[2] / 255.0;
-
-            double temp = 0.5 + std::log(g) - _alpha * std::log(b) - (1 - _alpha) * std::log(r);
-            if (temp > 1) temp = 1;
-            if (temp < 0) temp = 0;
-
-            if (_returnType == CV_8U)
-            {
-                out.at<uchar>(i, j) = (uchar) (temp * 255.0);
-            }
-            else if (_returnType == CV_64F)
-            {
-                out.at<double>(i, j) = temp;
-            }
+            kernel.illumination(bgr, out.cols, _logTable, _alpha, out.ptr<double>(i), nullptr);
         }
     }
 
@@ -25,6 +25,7 @@ namespace palm
     private:
         double _alpha;
         int _returnType;
+        double _logTable[256]; // log(v / 255) for every channel value
     };
 }
 
@@ -0,0 +1,35 @@
+#include "Kernels.h"
+#include "CpuFeatures.h"
+#include <opencv2/core.hpp>
+
+using namespace palm;
+
+
+const KernelTable &palm::kernels()
+{
+    return kernels(activeCpuIsa());
+}
+
+const KernelTable &palm::kernels(CpuIsa isa)
+{
+    switch (isa)
+    {
+#ifdef PALM_KERNELS_X86
+        case CpuIsa::SSE42:
+            return sse42KernelTable;
+        case CpuIsa::AVX2:
+            return avx2KernelTable;
+        case CpuIsa::AVX512:
+            return avx512KernelTable;
+#endif
+#ifdef PALM_KERNELS_NEON
+        case CpuIsa::NEON:
+            return neonKernelTable;
+#endif
+        case CpuIsa::Baseline:
+            return baselineKernelTable;
+
+        default:
+            CV_Error(cv::Error::StsBadArg, "Instruction set is not compiled into this build");
+    }
+}
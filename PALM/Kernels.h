@@ -0,0 +1,87 @@
+#ifndef PALM_KERNELS_H
+#define PALM_KERNELS_H
+
+#include <stddef.h>
+#include "CpuIsa.h"
+
+
+namespace palm
+{
+    // Hot loops of PALM. Every table is compiled from Kernels.inl with the flags of its instruction set, and the
+    // active one is chosen at runtime from the detected CPU features. Strides are given in elements.
+    struct KernelTable
+    {
+        CpuIsa isa;
+
+        // Evaluates the approximated filters on every 4x4 core of an area-averaged image. Cores whose mask entry is
+        // zero get code 0 without being evaluated; a null mask selects every core.
+        void (*approximatedPatterns)(const double *values, size_t valuesStride, int rows, int cols, int step,
+                                     int momentOrder, const unsigned char *mask, size_t maskStride,
+                                     unsigned char *patterns, size_t patternsStride);
+
+        // Produces the same codes as approximatedPatterns plus the given 4x4 core filters (see applyCoreFilters). The
+        // column pair sums and differences of every value row are computed once and shared by the cores of
+        // consecutive pattern rows, which combine them vertically into their mirrored basis (see
+        // applyMirroredApproximatedFilters). The core filters are given by their basis weights: terms termStart[k] to
+        // termStart[k + 1] - 1 of termBasis and termWeights, with maxWeight their largest absolute filter entry.
+        // Cores with a response too close to zero for the sign to be certain are evaluated directly, so the codes
+        // are identical. pairs is scratch memory of slidingPairsSize(cols) elements.
+        void (*slidingPatterns)(const double *values, size_t valuesStride, int rows, int cols, int step,
+                                int momentOrder, const double *coreFilters, int coreFilterCount, const int *termStart,
+                                const int *termBasis, const double *termWeights, double maxWeight,
+                                const unsigned char *mask, size_t maskStride, double *pairs, unsigned char *patterns,
+                                size_t patternsStride);
+        void (*slidingPatterns16)(const double *values, size_t valuesStride, int rows, int cols, int step,
+                                  int momentOrder, const double *coreFilters, int coreFilterCount,
+                                  const int *termStart, const int *termBasis, const double *termWeights,
+                                  double maxWeight, const unsigned char *mask, size_t maskStride, double *pairs,
+                                  unsigned short *patterns, size_t patternsStride);
+
+        // Adds the weight of every pixel to the bin given by its pattern code, skipping pixels with a zero mask entry
+        void (*accumulateHistogram)(const unsigned char *codes, size_t codesStride, const double *weights,
+                                    size_t weightsStride, const unsigned char *mask, size_t maskStride, int rows,
+                                    int cols, double *histogram);
+
+        // Splits every code into groups of groupBits bits and adds the pixel weight to one bin of each group's
+        // sub-histogram, for 8-bit and 16-bit pattern codes
+        void (*accumulateGroupedHistogram)(const unsigned char *codes, size_t codesStride, const double *weights,
+                                           size_t weightsStride, const unsigned char *mask, size_t maskStride,
+                                           int rows, int cols, int groupBits, int groupCount, double *histogram);
+        void (*accumulateGroupedHistogram16)(const unsigned short *codes, size_t codesStride, const double *weights,
+                                             size_t weightsStride, const unsigned char *mask, size_t maskStride,
+                                             int rows, int cols, int groupBits, int groupCount, double *histogram);
+
+        // Converts a row of BGR pixels to the illumination invariant space, writing either doubles or bytes
+        void (*illumination)(const unsigned char *bgr, int count, const double *logTable, double alpha,
+                             double *out64, unsigned char *out8);
+
+        double (*l1Distance)(const double *a, const double *b, int length);
+    };
+
+
+    // slidingPatterns evaluates blocks of SLIDING_LANES neighbouring cores together and keeps the pairs of four value
+    // rows, padded to whole blocks
+    static const int SLIDING_LANES = 4;
+
+    inline size_t slidingPairsSize(int cols)
+    {
+        return (size_t) 16 * ((cols + SLIDING_LANES - 1) / SLIDING_LANES * SLIDING_LANES);
+    }
+
+
+    const KernelTable &kernels();
+    const KernelTable &kernels(CpuIsa isa);
+
+    // Plain data so that selecting a table never runs code compiled for another instruction set
+    extern const KernelTable baselineKernelTable;
+#ifdef PALM_KERNELS_X86
+    extern const KernelTable sse42KernelTable;
+    extern const KernelTable avx2KernelTable;
+    extern const KernelTable avx512KernelTable;
+#endif
+#ifdef PALM_KERNELS_NEON
+    extern const KernelTable neonKernelTable;
+#endif
+}
+
+#endif //PALM_KERNELS_H
@@ -0,0 +1,379 @@
+// Shared body of the kernel tables. Included by one translation unit per instruction set, each compiled with its
+// own target flags and defining PALM_KERNEL_NAMESPACE, PALM_KERNEL_ISA and PALM_KERNEL_TABLE before inclusion.
+
+#include "Kernels.h"
+#include "ApproximatedFilters.h"
+
+#if defined(__SSE4_2__) || defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+namespace palm
+{
+    namespace PALM_KERNEL_NAMESPACE
+    {
+        static void approximatedPatterns(const double *values, size_t valuesStride, int rows, int cols, int step,
+                                         int momentOrder, const unsigned char *mask, size_t maskStride,
+                                         unsigned char *patterns, size_t patternsStride)
+        {
+            double v[4][4];
+            for (int r = 0; r < rows; r++)
+            {
+                const double *row = values + (size_t) r * step * valuesStride;
+                const unsigned char *valid = mask != nullptr ? mask + (size_t) r * maskStride : nullptr;
+                unsigned char *out = patterns + (size_t) r * patternsStride;
+
+                for (int c = 0; c < cols; c++)
+                {
+                    if (valid != nullptr && valid[c] == 0)
+                    {
+                        out[c] = 0;
+                        continue;
+                    }
+
+                    const double *core = row + (size_t) c * step;
+                    for (int i = 0; i < 4; i++)
+                    {
+                        for (int j = 0; j < 4; j++)
+                        {
+                            v[i][j] = core[i * valuesStride + j];
+                        }
+                    }
+
+                    out[c] = applyApproximatedFilters(v, momentOrder);
+                }
+            }
+        }
+
+        template<typename T>
+        static void slidingPatterns(const double *values, size_t valuesStride, int rows, int cols, int step,
+                                    int momentOrder, const double *coreFilters, int coreFilterCount,
+                                    const int *termStart, const int *termBasis, const double *termWeights,
+                                    double maxWeight, const unsigned char *mask, size_t maskStride, double *pairs,
+                                    T *patterns, size_t patternsStride)
+        {
+            maxWeight = maxWeight > 1 ? maxWeight : 1; // At least the largest weight of the hand-typed filters
+
+            // Every basis element is at most 4 * maxValue in magnitude, and rounding and dropped weights move a
+            // response by orders of magnitude less than the tolerance. Responses within it may have a different sign
+            // than the direct evaluation, so those cores are evaluated directly and the codes stay identical.
+            int usedRows = (rows - 1) * step + 4;
+            int usedCols = (cols - 1) * step + 4;
+            double maxValue = 0;
+            for (int y = 0; y < usedRows; y++)
+            {
+                const double *line = values + (size_t) y * valuesStride;
+                for (int x = 0; x < usedCols; x++)
+                {
+                    double magnitude = line[x] < 0 ? -line[x] : line[x];
+                    maxValue = magnitude > maxValue ? magnitude : maxValue;
+                }
+            }
+            double tolerance = 1e-12 * 64 * maxWeight * maxValue;
+
+            // Column pair sums and differences of the last four value rows, shared by the cores of consecutive pattern
+            // rows that overlap them. Rows are padded with zeros to whole blocks of cores.
+            const int L = SLIDING_LANES;
+            int paddedCols = (cols + L - 1) / L * L;
+            size_t slotSize = (size_t) 4 * paddedCols;
+            for (size_t e = 0; e < 4 * slotSize; e++)
+            {
+                pairs[e] = 0;
+            }
+            int slotRows[4] = {-1, -1, -1, -1};
+            const double *slots[4];
+
+            double v[4][4];
+            double m[4][4][L];
+            unsigned int codes[L];
+            double nearest[L];
+
+            for (int r = 0; r < rows; r++)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    int y = r * step + i;
+                    double *slot = pairs + (y & 3) * slotSize;
+                    slots[i] = slot;
+
+                    if (slotRows[y & 3] == y)
+                    {
+                        continue;
+                    }
+                    slotRows[y & 3] = y;
+
+                    const double *line = values + (size_t) y * valuesStride;
+                    for (int c = 0; c < cols; c++)
+                    {
+                        const double *p = line + (size_t) c * step;
+                        slot[c] = p[0] + p[3];
+                        slot[paddedCols + c] = p[1] + p[2];
+                        slot[2 * paddedCols + c] = p[0] - p[3];
+                        slot[3 * paddedCols + c] = p[1] - p[2];
+                    }
+                }
+
+                const unsigned char *valid = mask != nullptr ? mask + (size_t) r * maskStride : nullptr;
+                T *out = patterns + (size_t) r * patternsStride;
+
+                // Blocks of L neighbouring cores, evaluated together so that the filter expressions vectorize
+                for (int first = 0; first < cols; first += L)
+                {
+                    int count = cols - first < L ? cols - first : L;
+
+                    // A block without a valid core is not evaluated
+                    bool anyValid = valid == nullptr;
+                    for (int l = 0; l < count && !anyValid; l++)
+                    {
+                        anyValid = valid[first + l] != 0;
+                    }
+                    if (!anyValid)
+                    {
+                        for (int l = 0; l < count; l++)
+                        {
+                            out[first + l] = 0;
+                        }
+                        continue;
+                    }
+
+                    for (int b = 0; b < 4; b++)
+                    {
+                        size_t e = (size_t) b * paddedCols + first;
+                        for (int l = 0; l < L; l++)
+                        {
+                            m[0][b][l] = slots[0][e + l] + slots[3][e + l];
+                            m[1][b][l] = slots[1][e + l] + slots[2][e + l];
+                            m[2][b][l] = slots[0][e + l] - slots[3][e + l];
+                            m[3][b][l] = slots[1][e + l] - slots[2][e + l];
+                        }
+                    }
+
+                    applyMirroredApproximatedFilters<L>(m, momentOrder, codes, nearest);
+
+                    for (int k = 0; k < coreFilterCount; k++)
+                    {
+                        double sum[L] = {0};
+                        for (int t = termStart[k]; t < termStart[k + 1]; t++)
+                        {
+                            const double *element = &m[0][0][0] + termBasis[t] * L;
+                            double weight = termWeights[t];
+                            for (int l = 0; l < L; l++)
+                            {
+                                sum[l] += element[l] * weight;
+                            }
+                        }
+
+                        for (int l = 0; l < L; l++)
+                        {
+                            codes[l] |= (unsigned int) (sum[l] > 0) << (APPROXIMATED_FILTER_COUNT + k);
+                            nearest[l] = nearestResponse(nearest[l], sum[l]);
+                        }
+                    }
+
+                    for (int l = 0; l < count; l++)
+                    {
+                        int c = first + l;
+                        if (valid != nullptr && valid[c] == 0)
+                        {
+                            out[c] = 0;
+                            continue;
+                        }
+
+                        unsigned int code = codes[l];
+                        if (nearest[l] <= tolerance)
+                        {
+                            const double *core = values + (size_t) r * step * valuesStride + (size_t) c * step;
+                            for (int i = 0; i < 4; i++)
+                            {
+                                for (int j = 0; j < 4; j++)
+                                {
+                                    v[i][j] = core[i * valuesStride + j];
+                                }
+                            }
+
+                            code = applyApproximatedFilters(v, momentOrder) |
+                                   applyCoreFilters(v, coreFilters, coreFilterCount, APPROXIMATED_FILTER_COUNT);
+                        }
+
+                        out[c] = (T) code;
+                    }
+                }
+            }
+        }
+
+        static void accumulateHistogram(const unsigned char *codes, size_t codesStride, const double *weights,
+                                        size_t weightsStride, const unsigned char *mask, size_t maskStride, int rows,
+                                        int cols, double *histogram)
+        {
+            for (int i = 0; i < rows; i++)
+            {
+                const unsigned char *code = codes + (size_t) i * codesStride;
+                const double *weight = weights + (size_t) i * weightsStride;
+
+                if (mask == nullptr)
+                {
+                    for (int j = 0; j < cols; j++)
+                    {
+                        histogram[code[j]] += weight[j];
+                    }
+                    continue;
+                }
+
+                const unsigned char *valid = mask + (size_t) i * maskStride;
+                for (int j = 0; j < cols; j++)
+                {
+                    if (valid[j] != 0)
+                    {
+                        histogram[code[j]] += weight[j];
+                    }
+                }
+            }
+        }
+
+        // Every code adds the weight to one bin per group of groupBits bits; group g owns the bins from g << groupBits
+        template<typename Code>
+        static void accumulateGroupedHistogram(const Code *codes, size_t codesStride, const double *weights,
+                                               size_t weightsStride, const unsigned char *mask, size_t maskStride,
+                                               int rows, int cols, int groupBits, int groupCount, double *histogram)
+        {
+            const unsigned int groupMask = (1u << groupBits) - 1;
+
+            for (int i = 0; i < rows; i++)
+            {
+                const Code *code = codes + (size_t) i * codesStride;
+                const double *weight = weights + (size_t) i * weightsStride;
+                const unsigned char *valid = mask != nullptr ? mask + (size_t) i * maskStride : nullptr;
+
+                for (int j = 0; j < cols; j++)
+                {
+                    if (valid != nullptr && valid[j] == 0)
+                    {
+                        continue;
+                    }
+
+                    unsigned int value = code[j];
+                    for (int g = 0; g < groupCount; g++)
+                    {
+                        histogram[(g << groupBits) + ((value >> (g * groupBits)) & groupMask)] += weight[j];
+                    }
+                }
+            }
+        }
+
+        static void illumination(const unsigned char *bgr, int count, const double *logTable, double alpha,
+                                 double *out64, unsigned char *out8)
+        {
+            for (int k = 0; k < count; k++)
+            {
+                const unsigned char *pixel = bgr + 3 * k;
+
+                // Same expression as the per-pixel logarithms, with log(v / 255) looked up per channel value
+                double temp = 0.5 + logTable[pixel[1]] - alpha * logTable[pixel[0]] - (1 - alpha) * logTable[pixel[2]];
+                if (temp > 1) temp = 1;
+                if (temp < 0) temp = 0;
+
+                if (out64 != nullptr)
+                {
+                    out64[k] = temp;
+                }
+                else
+                {
+                    out8[k] = (unsigned char) (temp * 255.0);
+                }
+            }
+        }
+
+        // Every variant sums element k into accumulator k % 8, combines the accumulators in the same order and adds
+        // the tail last, so all instruction sets return the same bits
+        static double l1Distance(const double *a, const double *b, int length)
+        {
+            int k = 0;
+            double t[4]; // Accumulators l and l + 4 added
+
+#if defined(__AVX512F__)
+            __m512d acc = _mm512_setzero_pd();
+            for (; k + 8 <= length; k += 8)
+            {
+                acc = _mm512_add_pd(acc, _mm512_abs_pd(_mm512_sub_pd(_mm512_loadu_pd(a + k), _mm512_loadu_pd(b + k))));
+            }
+            _mm256_storeu_pd(t, _mm256_add_pd(_mm512_castpd512_pd256(acc), _mm512_extractf64x4_pd(acc, 1)));
+#elif defined(__AVX2__)
+            const __m256d signMask = _mm256_set1_pd(-0.0);
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            for (; k + 8 <= length; k += 8)
+            {
+                __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k));
+                __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + k + 4), _mm256_loadu_pd(b + k + 4));
+                acc0 = _mm256_add_pd(acc0, _mm256_andnot_pd(signMask, d0));
+                acc1 = _mm256_add_pd(acc1, _mm256_andnot_pd(signMask, d1));
+            }
+            _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+#elif defined(__SSE4_2__)
+            const __m128d signMask = _mm_set1_pd(-0.0);
+            __m128d acc[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+            for (; k + 8 <= length; k += 8)
+            {
+                for (int l = 0; l < 4; l++)
+                {
+                    __m128d d = _mm_sub_pd(_mm_loadu_pd(a + k + 2 * l), _mm_loadu_pd(b + k + 2 * l));
+                    acc[l] = _mm_add_pd(acc[l], _mm_andnot_pd(signMask, d));
+                }
+            }
+            _mm_storeu_pd(t, _mm_add_pd(acc[0], acc[2]));
+            _mm_storeu_pd(t + 2, _mm_add_pd(acc[1], acc[3]));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            float64x2_t acc[4] = {vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0)};
+            for (; k + 8 <= length; k += 8)
+            {
+                for (int l = 0; l < 4; l++)
+                {
+                    acc[l] = vaddq_f64(acc[l], vabdq_f64(vld1q_f64(a + k + 2 * l), vld1q_f64(b + k + 2 * l)));
+                }
+            }
+            vst1q_f64(t, vaddq_f64(acc[0], acc[2]));
+            vst1q_f64(t + 2, vaddq_f64(acc[1], acc[3]));
+#else
+            double acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            for (; k + 8 <= length; k += 8)
+            {
+                for (int l = 0; l < 8; l++)
+                {
+                    double d = a[k + l] - b[k + l];
+                    acc[l] += d < 0 ? -d : d;
+                }
+            }
+            for (int l = 0; l < 4; l++)
+            {
+                t[l] = acc[l] + acc[l + 4];
+            }
+#endif
+
+            double sum = (t[0] + t[2]) + (t[1] + t[3]);
+
+            for (; k < length; k++)
+            {
+                double d = a[k] - b[k];
+                sum += d < 0 ? -d : d;
+            }
+
+            return sum;
+        }
+    }
+
+    const KernelTable PALM_KERNEL_TABLE = {
+            PALM_KERNEL_ISA,
+            PALM_KERNEL_NAMESPACE::approximatedPatterns,
+            PALM_KERNEL_NAMESPACE::slidingPatterns<unsigned char>,
+            PALM_KERNEL_NAMESPACE::slidingPatterns<unsigned short>,
+            PALM_KERNEL_NAMESPACE::accumulateHistogram,
+            PALM_KERNEL_NAMESPACE::accumulateGroupedHistogram<unsigned char>,
+            PALM_KERNEL_NAMESPACE::accumulateGroupedHistogram<unsigned short>,
+            PALM_KERNEL_NAMESPACE::illumination,
+            PALM_KERNEL_NAMESPACE::l1Distance
+    };
+}
@@ -0,0 +1,5 @@
+#define PALM_KERNEL_NAMESPACE avx2
+#define PALM_KERNEL_ISA CpuIsa::AVX2
+#define PALM_KERNEL_TABLE avx2KernelTable
+
+#include "Kernels.inl"
@@ -0,0 +1,5 @@
+#define PALM_KERNEL_NAMESPACE avx512
+#define PALM_KERNEL_ISA CpuIsa::AVX512
+#define PALM_KERNEL_TABLE avx512KernelTable
+
+#include "Kernels.inl"
@@ -0,0 +1,5 @@
+#define PALM_KERNEL_NAMESPACE baseline
+#define PALM_KERNEL_ISA CpuIsa::Baseline
+#define PALM_KERNEL_TABLE baselineKernelTable
+
+#include "Kernels.inl"
@@ -0,0 +1,5 @@
+#define PALM_KERNEL_NAMESPACE neon
+#define PALM_KERNEL_ISA CpuIsa::NEON
+#define PALM_KERNEL_TABLE neonKernelTable
+
+#include "Kernels.inl"
@@ -0,0 +1,5 @@
+#define PALM_KERNEL_NAMESPACE sse42
+#define PALM_KERNEL_ISA CpuIsa::SSE42
+#define PALM_KERNEL_TABLE sse42KernelTable
+
+#include "Kernels.inl"
@@ -0,0 +1,123 @@
+#include "KeyframeGate.h"
+
+using namespace palm;
+
+
+KeyframeGate::KeyframeGate(cv::Ptr<PALM> palm, double threshold, cv::Size signatureSize)
+        : _PALM(palm), _normalizeBrightness(true)
+{
+    CV_Assert(palm != nullptr && palm->isInitialized());
+
+    setThreshold(threshold);
+    setSignatureSize(signatureSize);
+    reset();
+}
+
+void KeyframeGate::setThreshold(double threshold)
+{
+    CV_Assert(threshold >= 0);
+
+    _threshold = threshold;
+}
+
+void KeyframeGate::setSignatureSize(cv::Size signatureSize)
+{
+    CV_Assert(signatureSize.width > 0 && signatureSize.height > 0);
+
+    _signatureSize = signatureSize;
+    _KeyframeSignature.release();
+}
+
+void KeyframeGate::setNormalizeBrightness(bool normalizeBrightness)
+{
+    _normalizeBrightness = normalizeBrightness;
+}
+
+void KeyframeGate::reset()
+{
+    _KeyframeSignature.release();
+    _lastChange = 0;
+    _hits = 0;
+    _misses = 0;
+}
+
+double KeyframeGate::hitRate() const
+{
+    long long total = _hits + _misses;
+
+    return total > 0 ? (double) _hits / total : 0.0;
+}
+
+bool KeyframeGate::process(const cv::Mat &image, cv::Mat &descriptor)
+{
+    CV_Assert(!image.empty() && image.channels() == 1);
+
+    cv::Ptr<PatternImageExtractor> extractor = _PALM->patternImageExtractor();
+    cv::Ptr<ApproximatedPatternImageExtractor> approximated = extractor.dynamicCast<ApproximatedPatternImageExtractor>();
+
+    cv::Mat values;
+    if (approximated != nullptr)
+    {
+        values = approximated->downsample(image);
+    }
+    else
+    {
+        image.convertTo(values, CV_64F);
+    }
+
+    cv::Mat current = signature(values);
+
+    if (!_KeyframeSignature.empty())
+    {
+        _lastChange = change(current, _KeyframeSignature);
+        if (_lastChange < _threshold)
+        {
+            _hits++;
+            return false;
+        }
+    }
+    else
+    {
+        _lastChange = 0;
+    }
+
+    _misses++;
+    _KeyframeSignature = current;
+
+    // The static mask of PALM applies to keyframes as it does in extractPatterns()
+    cv::Mat patterns;
+    if (approximated != nullptr)
+    {
+        cv::Mat patternMask = _PALM->getPatternMask();
+        CV_Assert(patternMask.empty() || image.size() == _PALM->getMask().size());
+
+        patterns = approximated->extractDownsampled(values, patternMask);
+    }
+    else
+    {
+        patterns = _PALM->extractPatterns(image);
+    }
+
+    descriptor = _PALM->buildDescriptor(patterns);
+
+    return true;
+}
+
+cv::Mat KeyframeGate::signature(const cv::Mat &values) const
+{
+    cv::Mat thumbnail;
+    cv::resize(values, thumbnail, _signatureSize, 0, 0, cv::INTER_AREA);
+
+    if (_normalizeBrightness)
+    {
+        thumbnail -= cv::mean(thumbnail);
+    }
+
+    return thumbnail;
+}
+
+double KeyframeGate::change(const cv::Mat &signature1, const cv::Mat &signature2) const
+{
+    // Mean absolute difference, in the gray levels of the input image
+    return cv::norm(signature1, signature2, cv::NORM_L1) / signature1.total();
+}
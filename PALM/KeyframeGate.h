@@ -0,0 +1,55 @@
+#ifndef PALM_KEYFRAMEGATE_H
+#define PALM_KEYFRAMEGATE_H
+
+#include "PALM.h"
+
+
+namespace palm
+{
+    // Skips descriptor computation for frames that barely differ from the last keyframe. Frames are compared through
+    // a small thumbnail; with the approximated filters the thumbnail is taken from the area-averaged image the
+    // extractor needs anyway, so a keyframe pays for the downsampling only once.
+    class KeyframeGate
+    {
+    public:
+        KeyframeGate(cv::Ptr<PALM> palm, double threshold = 4.0, cv::Size signatureSize = cv::Size(16, 16));
+        virtual ~KeyframeGate() { };
+
+        double getThreshold() const { return _threshold; }
+        void setThreshold(double threshold);
+
+        cv::Size getSignatureSize() const { return _signatureSize; }
+        void setSignatureSize(cv::Size signatureSize);
+
+        bool isBrightnessNormalized() const { return _normalizeBrightness; }
+        void setNormalizeBrightness(bool normalizeBrightness);
+
+        // Returns true and fills the descriptor when the frame becomes a new keyframe
+        virtual bool process(const cv::Mat &image, cv::Mat &descriptor);
+        virtual void reset();
+
+        double lastChange() const { return _lastChange; }
+        cv::Mat keyframeSignature() const { return _KeyframeSignature; }
+
+        long long hitCount() const { return _hits; }
+        long long missCount() const { return _misses; }
+        double hitRate() const;
+
+    protected:
+        virtual cv::Mat signature(const cv::Mat &values) const;
+        virtual double change(const cv::Mat &signature1, const cv::Mat &signature2) const;
+
+    private:
+        cv::Ptr<PALM> _PALM;
+        double _threshold;
+        cv::Size _signatureSize;
+        bool _normalizeBrightness;
+
+        cv::Mat _KeyframeSignature;
+        double _lastChange;
+        long long _hits;
+        long long _misses;
+    };
+}
+
+#endif //PALM_KEYFRAMEGATE_H
@@ -0,0 +1,266 @@
+#include "MapSummarizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+using namespace palm;
+
+
+static const char SUMMARY_MAGIC[8] = {'P', 'A', 'L', 'M', 'S', 'U', 'M', 'M'};
+static const int SUMMARY_VERSION = 1;
+
+template<typename T>
+static void writeValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::istream &stream, T &value)
+{
+    return (bool) stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeValues(std::ostream &stream, const std::vector<T> &values)
+{
+    stream.write(reinterpret_cast<const char *>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+}
+
+template<typename T>
+static bool readValues(std::istream &stream, std::vector<T> &values, size_t count)
+{
+    values.resize(count);
+    return (bool) stream.read(reinterpret_cast<char *>(values.data()), (std::streamsize) (count * sizeof(T)));
+}
+
+
+MapSummarizer::MapSummarizer(int descriptorSize, int cellLength, double threshold, MergePolicy mergePolicy)
+        : _descriptorSize(descriptorSize), _cellLength(cellLength), _threshold(threshold), _mergePolicy(mergePolicy),
+          _Distance(descriptorSize, cellLength)
+{
+    CV_Assert(threshold >= 0);
+}
+
+int MapSummarizer::add(const cv::Mat &descriptor)
+{
+    CV_Assert(descriptor.type() == CV_64F && descriptor.rows == 1 && descriptor.cols == _descriptorSize);
+
+    const double *values = descriptor.ptr<double>(0);
+
+    // The bound shrinks to the best distance so far, so most representatives are rejected after a few cells
+    int nearest = -1;
+    double bound = _threshold;
+    for (int i = 0; i < size(); i++)
+    {
+        double distance = _Distance.compute(values, row(i), bound);
+        if (distance < bound)
+        {
+            bound = distance;
+            nearest = i;
+        }
+    }
+
+    if (nearest < 0)
+    {
+        nearest = size();
+        _Representatives.insert(_Representatives.end(), values, values + _descriptorSize);
+        if (_mergePolicy == MergePolicy::RunningMean)
+        {
+            _Sums.insert(_Sums.end(), values, values + _descriptorSize);
+        }
+        _Counts.push_back(1);
+    }
+    else
+    {
+        _Counts[nearest]++;
+        if (_mergePolicy == MergePolicy::RunningMean)
+        {
+            merge(nearest, values);
+        }
+    }
+
+    _FrameRepresentatives.push_back(nearest);
+
+    return nearest;
+}
+
+void MapSummarizer::merge(int representative, const double *descriptor)
+{
+    double *sum = _Sums.data() + (size_t) representative * _descriptorSize;
+    double *mean = _Representatives.data() + (size_t) representative * _descriptorSize;
+
+    for (int k = 0; k < _descriptorSize; k++)
+    {
+        sum[k] += descriptor[k];
+    }
+
+    // Cells are normalized again like the histogram cells, so representatives stay comparable with new descriptors
+    for (int cell = 0; cell < _descriptorSize; cell += _cellLength)
+    {
+        double norm = 0;
+        for (int k = cell; k < cell + _cellLength; k++)
+        {
+            norm += sum[k] * sum[k];
+        }
+
+        double scale = 1.0 / (std::sqrt(norm) + std::numeric_limits<double>::epsilon());
+        for (int k = cell; k < cell + _cellLength; k++)
+        {
+            mean[k] = sum[k] * scale;
+        }
+    }
+}
+
+const double *MapSummarizer::row(int representative) const
+{
+    return _Representatives.data() + (size_t) representative * _descriptorSize;
+}
+
+int MapSummarizer::representative(int frame) const
+{
+    CV_Assert(frame >= 0 && frame < frameCount());
+
+    return _FrameRepresentatives[frame];
+}
+
+int MapSummarizer::memberCount(int representative) const
+{
+    CV_Assert(representative >= 0 && representative < size());
+
+    return _Counts[representative];
+}
+
+cv::Mat MapSummarizer::descriptor(int representative) const
+{
+    CV_Assert(representative >= 0 && representative < size());
+
+    return cv::Mat(1, _descriptorSize, CV_64F, const_cast<double *>(row(representative))).clone();
+}
+
+cv::Mat MapSummarizer::descriptors() const
+{
+    if (size() == 0)
+    {
+        return cv::Mat();
+    }
+
+    return cv::Mat(size(), _descriptorSize, CV_64F, const_cast<double *>(_Representatives.data())).clone();
+}
+
+std::vector<DescriptorMatch> MapSummarizer::search(const cv::Mat &query, int k) const
+{
+    CV_Assert(k > 0);
+    CV_Assert(query.type() == CV_64F && query.rows == 1 && query.cols == _descriptorSize);
+
+    TopMatches matches(k);
+    const double *q = query.ptr<double>(0);
+
+    for (int i = 0; i < size(); i++)
+    {
+        double bound = matches.bound();
+        double distance = _Distance.compute(q, row(i), bound);
+
+        if (distance <= bound)
+        {
+            matches.push(i, distance);
+        }
+    }
+
+    return matches.sorted();
+}
+
+void MapSummarizer::save(const std::string &path) const
+{
+    std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+    CV_Assert(stream.is_open());
+
+    stream.write(SUMMARY_MAGIC, sizeof(SUMMARY_MAGIC));
+    writeValue<int>(stream, SUMMARY_VERSION);
+    writeValue<int>(stream, _descriptorSize);
+    writeValue<int>(stream, _cellLength);
+    writeValue<double>(stream, _threshold);
+    writeValue<int>(stream, (int) _mergePolicy);
+    writeValue<int>(stream, size());
+    writeValue<int>(stream, frameCount());
+
+    writeValues(stream, _Representatives);
+    writeValues(stream, _Sums);
+    writeValues(stream, _Counts);
+    writeValues(stream, _FrameRepresentatives);
+
+    CV_Assert(stream.good());
+}
+
+cv::Ptr<MapSummarizer> MapSummarizer::load(const std::string &path)
+{
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    CV_Assert(stream.is_open());
+
+    char magic[sizeof(SUMMARY_MAGIC)];
+    int version, descriptorSize, cellLength, mergePolicy, size, frameCount;
+    double threshold;
+
+    if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, SUMMARY_MAGIC, sizeof(magic)) != 0 ||
+        !readValue<int>(stream, version))
+    {
+        CV_Error(cv::Error::StsParseError, "Not a PALM map summary file");
+    }
+    if (version != SUMMARY_VERSION)
+    {
+        CV_Error(cv::Error::StsUnsupportedFormat, "Unsupported PALM map summary file version");
+    }
+
+    // The header is checked before any allocation depends on it
+    bool valid = readValue<int>(stream, descriptorSize) && readValue<int>(stream, cellLength) &&
+                 readValue<double>(stream, threshold) && readValue<int>(stream, mergePolicy) &&
+                 readValue<int>(stream, size) && readValue<int>(stream, frameCount) &&
+                 descriptorSize > 0 && cellLength > 0 && descriptorSize % cellLength == 0 && threshold >= 0 &&
+                 (mergePolicy == (int) MergePolicy::KeepFirst || mergePolicy == (int) MergePolicy::RunningMean) &&
+                 size >= 0 && frameCount >= size;
+    if (!valid)
+    {
+        CV_Error(cv::Error::StsParseError, "Invalid PALM map summary header");
+    }
+
+    // The counts must fit into the rest of the file, so a damaged header cannot cause a huge allocation
+    std::streamoff headerEnd = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    double remaining = (double) (stream.tellg() - headerEnd);
+    stream.seekg(headerEnd);
+
+    int valueArrays = mergePolicy == (int) MergePolicy::RunningMean ? 2 : 1;
+    double required = (double) valueArrays * size * descriptorSize * sizeof(double) +
+                      ((double) size + frameCount) * sizeof(int);
+    if (required != remaining)
+    {
+        CV_Error(cv::Error::StsParseError, "Truncated PALM map summary file");
+    }
+
+    cv::Ptr<MapSummarizer> summarizer = new MapSummarizer(descriptorSize, cellLength, threshold,
+                                                          (MergePolicy) mergePolicy);
+    size_t values = (size_t) size * descriptorSize;
+
+    valid = readValues(stream, summarizer->_Representatives, values) &&
+            readValues(stream, summarizer->_Sums, mergePolicy == (int) MergePolicy::RunningMean ? values : 0) &&
+            readValues(stream, summarizer->_Counts, (size_t) size) &&
+            readValues(stream, summarizer->_FrameRepresentatives, (size_t) frameCount);
+    if (!valid)
+    {
+        CV_Error(cv::Error::StsParseError, "Truncated PALM map summary file");
+    }
+
+    // Every representative must have the members the frames refer to it with
+    std::vector<int> members((size_t) size, 0);
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        int representative = summarizer->_FrameRepresentatives[frame];
+        CV_Assert(representative >= 0 && representative < size);
+        members[representative]++;
+    }
+    CV_Assert(members == summarizer->_Counts);
+
+    return summarizer;
+}
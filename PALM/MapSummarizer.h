@@ -0,0 +1,69 @@
+#ifndef PALM_MAPSUMMARIZER_H
+#define PALM_MAPSUMMARIZER_H
+
+#include "BoundedL1Distance.h"
+
+
+namespace palm
+{
+    enum class MergePolicy
+    {
+        KeepFirst,  // A representative stays the first descriptor of its place
+        RunningMean // A representative is the cell-wise normalized mean of the descriptors merged into it
+    };
+
+
+    // Online summary of a descriptor stream that keeps one representative per distinct place. A descriptor whose
+    // distance to its nearest representative is below the threshold is merged into that representative instead of
+    // being stored, so memory and search time grow with the number of places rather than the number of frames.
+    // Every frame keeps the index of the representative it was merged into.
+    // With MergePolicy::RunningMean a representative moves towards its members, so two representatives can end up
+    // closer than the threshold. They are not merged afterwards, since add() has already handed out both indices.
+    class MapSummarizer
+    {
+    public:
+        MapSummarizer(int descriptorSize, int cellLength, double threshold,
+                      MergePolicy mergePolicy = MergePolicy::KeepFirst);
+        virtual ~MapSummarizer() { };
+
+        int descriptorSize() const { return _descriptorSize; }
+        double getThreshold() const { return _threshold; }
+        MergePolicy getMergePolicy() const { return _mergePolicy; }
+        const BoundedL1Distance &distance() const { return _Distance; }
+
+        // Adds the descriptor of the next frame and returns the index of its representative
+        int add(const cv::Mat &descriptor);
+
+        int size() const { return (int) _Counts.size(); }
+        int frameCount() const { return (int) _FrameRepresentatives.size(); }
+        int representative(int frame) const;
+        int memberCount(int representative) const;
+
+        cv::Mat descriptor(int representative) const;
+        cv::Mat descriptors() const; // Representatives, one per row
+
+        std::vector<DescriptorMatch> search(const cv::Mat &query, int k) const; // Indices are representatives
+
+        // Stores the representatives, their member counts and the representative of every frame, so a summary
+        // can be continued or queried later
+        void save(const std::string &path) const;
+        static cv::Ptr<MapSummarizer> load(const std::string &path);
+
+    private:
+        const double *row(int representative) const;
+        void merge(int representative, const double *descriptor);
+
+        int _descriptorSize;
+        int _cellLength;
+        double _threshold;
+        MergePolicy _mergePolicy;
+        BoundedL1Distance _Distance;
+
+        std::vector<double> _Representatives;
+        std::vector<double> _Sums; // Per representative descriptor sums, for MergePolicy::RunningMean only
+        std::vector<int> _Counts;
+        std::vector<int> _FrameRepresentatives;
+    };
+}
+
+#endif //PALM_MAPSUMMARIZER_H
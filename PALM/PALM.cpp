@@ -1,4 +1,5 @@
 #include "PALM.h"
+#include "Kernels.h"
 
 using namespace palm;
 
@@ -11,6 +12,7 @@ PALMConfig::PALMConfig()
     momentOrder = 2;
     filterType = FilterType::Approximated;
     applyInsidePartitioning = true;
+    codeGroupBits = 8;
 }
 
 
@@ -41,9 +43,12 @@ void PALM::initialize()
                                                            _config.momentOrder);
 
     cv::Size gridSize = cv::Size(_config.gridSize, _config.gridSize);
-    int binCount = (int) std::pow(2, _PatternImageExtractor->filters().size());
+    int codeBits = (int) _PatternImageExtractor->filters().size();
 
-    _HistogramBuilder = new HistogramBuilder(gridSize, binCount, _config.applyInsidePartitioning);
+    _HistogramBuilder = new HistogramBuilder(gridSize, codeBits, _config.codeGroupBits,
+                                             _config.applyInsidePartitioning);
+    _BoundedDistance = new BoundedL1Distance(_HistogramBuilder->histogramLength(), _HistogramBuilder->getBinCount());
+    _PatternMask = _Mask.empty() ? cv::Mat() : _PatternImageExtractor->patternMask(_Mask);
 }
 
 bool PALM::isInitialized() const
@@ -66,23 +71,98 @@ cv::Mat PALM::lastPatternImage()
     return _LastPatternImage;
 }
 
+void PALM::setMask(const cv::Mat &mask)
+{
+    CV_Assert(mask.empty() || mask.type() == CV_8U);
+
+    _Mask = mask;
+    _PatternMask = _Mask.empty() || !isInitialized() ? cv::Mat() : _PatternImageExtractor->patternMask(_Mask);
+}
+
+cv::Mat PALM::regionMask(cv::Size imageSize, const cv::Rect &roi, const cv::Mat &mask) const
+{
+    CV_Assert(_Mask.empty() || _Mask.size() == imageSize);
+    CV_Assert(mask.empty() || (mask.type() == CV_8U && mask.size() == imageSize));
+
+    if (_Mask.empty())
+    {
+        return mask.empty() ? cv::Mat() : mask(roi);
+    }
+    if (mask.empty())
+    {
+        return _Mask(roi);
+    }
+
+    cv::Mat combined;
+    cv::bitwise_and(_Mask(roi), mask(roi), combined);
+
+    return combined;
+}
+
 std::vector<cv::Mat> PALM::filters() const
 {
     return _PatternImageExtractor->filters();
 }
 
+cv::Mat PALM::extractPatterns(const cv::Mat &image)
+{
+    CV_Assert(isInitialized());
+
+    if (_PatternMask.empty())
+    {
+        return _PatternImageExtractor->extract(image);
+    }
+
+    CV_Assert(image.size() == _Mask.size());
+
+    return _PatternImageExtractor->extract(image, _PatternMask);
+}
+
+cv::Mat PALM::buildDescriptor(const cv::Mat &patternImage)
+{
+    CV_Assert(isInitialized());
+
+    return _HistogramBuilder->build(patternImage, _PatternMask);
+}
+
 cv::Mat PALM::compute(const cv::Mat &image)
 {
     CV_Assert(isInitialized());
 
-    cv::Mat patterns = _PatternImageExtractor->extract(image);
+    cv::Mat patterns = extractPatterns(image);
     _LastPatternImage = patterns;
 
-    cv::Mat desc = _HistogramBuilder->build(patterns);
+    cv::Mat desc = buildDescriptor(patterns);
 
     return desc;
 }
 
+cv::Mat PALM::compute(const cv::Mat &image, const cv::Mat &mask)
+{
+    return compute(image, cv::Rect(0, 0, image.cols, image.rows), mask);
+}
+
+cv::Mat PALM::compute(const cv::Mat &image, const cv::Rect &roi, const cv::Mat &mask)
+{
+    CV_Assert(isInitialized());
+    CV_Assert(roi.x >= 0 && roi.y >= 0 && roi.x + roi.width <= image.cols && roi.y + roi.height <= image.rows);
+
+    // The region is a view into the image and the masks, nothing is copied before the extraction
+    cv::Mat region = image(roi);
+    cv::Mat regionMask = this->regionMask(image.size(), roi, mask);
+
+    if (regionMask.empty())
+    {
+        return compute(region);
+    }
+
+    cv::Mat patternMask = _PatternImageExtractor->patternMask(regionMask);
+    cv::Mat patterns = _PatternImageExtractor->extract(region, patternMask);
+    _LastPatternImage = patterns;
+
+    return _HistogramBuilder->build(patterns, patternMask);
+}
+
 cv::Mat PALM::compute(const std::vector<cv::Mat> &images, bool rowStack)
 {
     CV_Assert(isInitialized());
@@ -111,9 +191,45 @@ cv::Mat PALM::compute(const std::vector<cv::Mat> &images, bool rowStack)
     return descs;
 }
 
+SparseHistogram PALM::computeSparse(const cv::Mat &image)
+{
+    CV_Assert(isInitialized());
+
+    cv::Mat patterns = extractPatterns(image);
+    _LastPatternImage = patterns;
+
+    return _HistogramBuilder->buildSparse(patterns, _PatternMask);
+}
+
 double PALM::distance(const cv::Mat &desc1, const cv::Mat &desc2) const
 {
     CV_Assert(desc1.cols > 0 && desc1.rows == 1 && desc2.cols > 0 && desc2.rows == 1 && desc1.cols == desc2.cols);
+    CV_Assert(desc1.channels() == 1 && desc2.channels() == 1);
+
+    // Descriptors stored in other types, e.g. CV_32F, are widened exactly and measured by the same kernel
+    cv::Mat values1 = desc1, values2 = desc2;
+    if (desc1.type() != CV_64F)
+    {
+        desc1.convertTo(values1, CV_64F);
+    }
+    if (desc2.type() != CV_64F)
+    {
+        desc2.convertTo(values2, CV_64F);
+    }
+
+    return kernels().l1Distance(values1.ptr<double>(0), values2.ptr<double>(0), values1.cols);
+}
+
+double PALM::distance(const cv::Mat &desc1, const cv::Mat &desc2, double bound) const
+{
+    CV_Assert(isInitialized());
+
+    return _BoundedDistance->compute(desc1, desc2, bound);
+}
+
+double PALM::distance(const SparseHistogram &desc1, const SparseHistogram &desc2) const
+{
+    CV_Assert(desc1.length() > 0 && desc1.length() == desc2.length());
 
-    return cv::norm(desc1, desc2, cv::NORM_L1);
+    return SparseHistogram::distance(desc1, desc2);
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "PatternImageExtractor.h"
 #include "HistogramBuilder.h"
 #include "IlluminationFilter.h"
+#include "SparseHistogram.h"
+#include "BoundedL1Distance.h"
 
 
 namespace palm
@@ -21,6 +23,7 @@ namespace palm
         int momentOrder;
         FilterType filterType;
         bool applyInsidePartitioning;
+        int codeGroupBits; // Pattern codes longer than this get one sub-histogram per group of bits
     };
 
 
@@ -38,17 +41,40 @@ namespace palm
         virtual bool isInitialized() const;
         virtual int descriptorSize() const;
         virtual std::vector<cv::Mat> filters() const;
+        cv::Ptr<PatternImageExtractor> patternImageExtractor() const { return _PatternImageExtractor; }
+        cv::Ptr<HistogramBuilder> histogramBuilder() const { return _HistogramBuilder; }
+        cv::Ptr<BoundedL1Distance> boundedDistance() const { return _BoundedDistance; }
         virtual cv::Mat lastPatternImage();
+
+        // Static mask (e.g. a vehicle hood or a burned-in overlay) applied to every image; once set, every image
+        // must have the size of the mask. Patterns whose patch center falls on a zero mask pixel are not evaluated
+        // and are left out of the histograms.
+        void setMask(const cv::Mat &mask);
+        cv::Mat getMask() const { return _Mask; }
+        cv::Mat getPatternMask() const { return _PatternMask; } // The static mask in pattern image coordinates
+
+        virtual cv::Mat extractPatterns(const cv::Mat &image);
+        virtual cv::Mat buildDescriptor(const cv::Mat &patternImage);
         virtual cv::Mat compute(const cv::Mat &image);
+        virtual cv::Mat compute(const cv::Mat &image, const cv::Mat &mask); // Per-frame mask, combined with the static one
+        virtual cv::Mat compute(const cv::Mat &image, const cv::Rect &roi, const cv::Mat &mask = cv::Mat());
         virtual cv::Mat compute(const std::vector<cv::Mat> &images, bool rowStack = false);
+        virtual SparseHistogram computeSparse(const cv::Mat &image);
         virtual double distance(const cv::Mat &desc1, const cv::Mat &desc2) const;
+        virtual double distance(const cv::Mat &desc1, const cv::Mat &desc2, double bound) const;
+        virtual double distance(const SparseHistogram &desc1, const SparseHistogram &desc2) const;
 
     protected:
         cv::Ptr<PatternImageExtractor> _PatternImageExtractor;
         cv::Ptr<HistogramBuilder> _HistogramBuilder;
+        cv::Ptr<BoundedL1Distance> _BoundedDistance;
         cv::Mat _LastPatternImage;
+        cv::Mat _Mask;
+        cv::Mat _PatternMask;
 
     private:
+        cv::Mat regionMask(cv::Size imageSize, const cv::Rect &roi, const cv::Mat &mask) const;
+
         PALMConfig _config;
     };
 }
@@ -0,0 +1,415 @@
+#include "PALMPipeline.h"
+#include <chrono>
+
+using namespace palm;
+
+
+static void backoff(int &spins)
+{
+    if (spins < 64)
+    {
+        spins++;
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+
+PALMPipelineConfig::PALMPipelineConfig()
+{
+    queueCapacity = 8;
+    backpressurePolicy = BackpressurePolicy::Block;
+    dropPolicy = DropPolicy::DropOldest;
+    downsampleFactor = 1.0;
+    applyIlluminationFilter = false;
+    illuminationAlpha = 0.3;
+}
+
+
+PALMPipelineResult::PALMPipelineResult()
+{
+    frameId = -1;
+    dropped = false;
+    failed = false;
+    latency = 0;
+}
+
+
+PALMPipeline::PALMPipeline(PALMConfig config, PALMPipelineConfig pipelineConfig)
+        : _pipelineConfig(pipelineConfig), _running(false), _submitting(0), _submitted(0), _completed(0),
+          _dropped(0)
+{
+    CV_Assert(pipelineConfig.queueCapacity > 0);
+    CV_Assert(pipelineConfig.downsampleFactor > 0 && pipelineConfig.downsampleFactor <= 1);
+
+    _PALM = new PALM(config, true);
+
+    if (pipelineConfig.applyIlluminationFilter)
+    {
+        _IlluminationFilter = new IlluminationFilter(pipelineConfig.illuminationAlpha, CV_8U);
+    }
+
+    for (int stage = 0; stage < StageCount; stage++)
+    {
+        _Queues[stage].reset(new BoundedQueue<Frame *>((size_t) pipelineConfig.queueCapacity));
+        _Signals[stage].sleeping = false;
+        _finished[stage] = false;
+    }
+}
+
+PALMPipeline::~PALMPipeline()
+{
+    stop();
+}
+
+void PALMPipeline::setSink(Sink sink)
+{
+    CV_Assert(!_running);
+
+    _sink = sink;
+}
+
+void PALMPipeline::setCallback(Callback callback)
+{
+    CV_Assert(!_running);
+
+    _callback = callback;
+}
+
+void PALMPipeline::start()
+{
+    CV_Assert(!_running);
+
+    for (int stage = 0; stage < StageCount; stage++)
+    {
+        _finished[stage] = false;
+    }
+
+    _running = true;
+
+    for (int stage = 0; stage < StageCount; stage++)
+    {
+        _Threads[stage] = std::thread(&PALMPipeline::run, this, (Stage) stage);
+    }
+}
+
+void PALMPipeline::stop()
+{
+    // Concurrent calls wait for the first one, so every stage thread is joined once
+    std::lock_guard<std::mutex> lock(_StopMutex);
+    if (!_running)
+    {
+        return;
+    }
+
+    // Stages drain their queues in order before exiting, so every submitted frame is completed. A submit() that
+    // saw the pipeline running keeps the conversion stage alive until its frame is enqueued.
+    _running = false;
+    wake(ConvertStage);
+
+    for (int stage = 0; stage < StageCount; stage++)
+    {
+        if (_Threads[stage].joinable())
+        {
+            _Threads[stage].join();
+        }
+    }
+}
+
+std::future<PALMPipelineResult> PALMPipeline::submit(const cv::Mat &image)
+{
+    CV_Assert(!image.empty());
+
+    _submitting++;
+    if (!_running)
+    {
+        _submitting--;
+        CV_Error(cv::Error::StsError, "PALMPipeline is not running");
+    }
+
+    Frame *frame = new Frame();
+    frame->id = _submitted++;
+    frame->image = image;
+    frame->submitTick = cv::getTickCount();
+
+    std::future<PALMPipelineResult> result = frame->promise.get_future();
+
+    enqueue(ConvertStage, frame);
+    _submitting--;
+    wake(ConvertStage); // A stopping conversion stage may wait for this submit to finish
+
+    return result;
+}
+
+cv::Mat PALMPipeline::convert(const cv::Mat &image)
+{
+    cv::Mat gray;
+    if (image.channels() == 1)
+    {
+        gray = image;
+    }
+    else if (_IlluminationFilter != nullptr && image.type() == CV_8UC3)
+    {
+        gray = _IlluminationFilter->apply(image);
+    }
+    else
+    {
+        cv::cvtColor(image, gray, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+
+    double factor = _pipelineConfig.downsampleFactor;
+    if (factor < 1)
+    {
+        cv::resize(gray, gray, cv::Size(), factor, factor, cv::INTER_AREA);
+    }
+
+    return gray;
+}
+
+void PALMPipeline::process(Stage stage, Frame *frame)
+{
+    switch (stage)
+    {
+        case ConvertStage:
+            frame->image = convert(frame->image);
+            break;
+
+        case ExtractStage:
+            frame->patterns = _PALM->extractPatterns(frame->image);
+            frame->image.release();
+            break;
+
+        case HistogramStage:
+            frame->descriptor = _PALM->buildDescriptor(frame->patterns);
+            break;
+
+        default: // The sink stage is handled on completion
+            break;
+    }
+}
+
+void PALMPipeline::run(Stage stage)
+{
+    BoundedQueue<Frame *> &queue = *_Queues[stage];
+
+    int spins = 0;
+    for (;;)
+    {
+        Frame *frame = nullptr;
+        if (!queue.tryPop(frame))
+        {
+            // The upstream flag must be read before the final pop attempt, otherwise a last frame could be missed
+            bool finished = upstreamFinished(stage);
+            if (!queue.tryPop(frame))
+            {
+                if (finished)
+                {
+                    break;
+                }
+
+                // Spin briefly for frames that are about to arrive, then sleep until the upstream wakes this stage
+                if (spins < 64)
+                {
+                    spins++;
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    waitForFrames(stage);
+                }
+                continue;
+            }
+        }
+
+        spins = 0;
+
+        try
+        {
+            process(stage, frame);
+        }
+        catch (...)
+        {
+            fail(frame, std::current_exception());
+            continue;
+        }
+
+        if (stage + 1 < StageCount)
+        {
+            enqueue((Stage) (stage + 1), frame);
+        }
+        else
+        {
+            complete(frame, false);
+        }
+    }
+
+    _finished[stage] = true;
+    if (stage + 1 < StageCount)
+    {
+        wake((Stage) (stage + 1));
+    }
+}
+
+bool PALMPipeline::upstreamFinished(Stage stage) const
+{
+    return stage == ConvertStage ? !_running && _submitting == 0 : _finished[stage - 1].load();
+}
+
+void PALMPipeline::waitForFrames(Stage stage)
+{
+    StageSignal &signal = _Signals[stage];
+
+    // The flag is raised before the last check: a producer either makes the check fail or sees the flag and
+    // notifies under the mutex, which this stage only releases inside wait()
+    std::unique_lock<std::mutex> lock(signal.mutex);
+    signal.sleeping = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (_Queues[stage]->empty() && !upstreamFinished(stage))
+    {
+        signal.condition.wait(lock);
+    }
+
+    signal.sleeping = false;
+}
+
+void PALMPipeline::wake(Stage stage)
+{
+    StageSignal &signal = _Signals[stage];
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (signal.sleeping)
+    {
+        std::lock_guard<std::mutex> lock(signal.mutex);
+        signal.condition.notify_one();
+    }
+}
+
+bool PALMPipeline::enqueue(Stage stage, Frame *frame)
+{
+    BoundedQueue<Frame *> &queue = *_Queues[stage];
+
+    int spins = 0;
+    while (!queue.tryPush(frame))
+    {
+        if (_pipelineConfig.backpressurePolicy == BackpressurePolicy::Block)
+        {
+            backoff(spins);
+        }
+        else if (_pipelineConfig.dropPolicy == DropPolicy::DropNewest)
+        {
+            complete(frame, true);
+            return false;
+        }
+        else
+        {
+            Frame *oldest = nullptr;
+            if (queue.tryPop(oldest))
+            {
+                complete(oldest, true);
+            }
+        }
+    }
+
+    wake(stage);
+    return true;
+}
+
+void PALMPipeline::complete(Frame *frame, bool dropped)
+{
+    PALMPipelineResult result;
+    result.frameId = frame->id;
+    result.dropped = dropped;
+
+    if (!dropped)
+    {
+        result.descriptor = frame->descriptor;
+        result.patternImage = frame->patterns;
+    }
+
+    // The sink runs on its own stage thread; dropped frames never reach it
+    if (!dropped && _sink)
+    {
+        try
+        {
+            _sink(result);
+        }
+        catch (...)
+        {
+            fail(frame, std::current_exception());
+            return;
+        }
+    }
+
+    result.latency = (cv::getTickCount() - frame->submitTick) * 1000.0 / cv::getTickFrequency();
+
+    if (dropped)
+    {
+        _dropped++;
+    }
+    else
+    {
+        _completed++;
+    }
+
+    deliver(frame, result, nullptr);
+}
+
+void PALMPipeline::fail(Frame *frame, std::exception_ptr error)
+{
+    PALMPipelineResult result;
+    result.frameId = frame->id;
+    result.failed = true;
+    result.latency = (cv::getTickCount() - frame->submitTick) * 1000.0 / cv::getTickFrequency();
+
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::exception &e)
+    {
+        result.error = e.what();
+    }
+    catch (...)
+    {
+        result.error = "unknown exception";
+    }
+
+    _completed++;
+
+    deliver(frame, result, error);
+}
+
+void PALMPipeline::deliver(Frame *frame, const PALMPipelineResult &result, std::exception_ptr error)
+{
+    if (_callback)
+    {
+        // Results arrive from several threads; the mutex serializes the calls
+        std::lock_guard<std::mutex> lock(_CallbackMutex);
+        try
+        {
+            _callback(result);
+        }
+        catch (...)
+        {
+            // Passed to the future rather than ending the stage thread
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if (error)
+    {
+        frame->promise.set_exception(error);
+    }
+    else
+    {
+        frame->promise.set_value(result);
+    }
+    delete frame;
+}
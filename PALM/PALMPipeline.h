@@ -0,0 +1,155 @@
+#ifndef PALM_PALMPIPELINE_H
+#define PALM_PALMPIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "PALM.h"
+#include "BoundedQueue.h"
+
+
+namespace palm
+{
+    enum class BackpressurePolicy
+    {
+        Block,  // Wait until the next stage has room
+        Drop    // Drop a frame according to the drop policy
+    };
+
+
+    enum class DropPolicy
+    {
+        DropNewest, // Discard the frame that does not fit
+        DropOldest  // Discard the oldest queued frame to make room
+    };
+
+
+    class PALMPipelineConfig
+    {
+    public:
+        PALMPipelineConfig();
+        virtual ~PALMPipelineConfig() { };
+
+        int queueCapacity;
+        BackpressurePolicy backpressurePolicy;
+        DropPolicy dropPolicy;
+        double downsampleFactor;
+        bool applyIlluminationFilter;
+        double illuminationAlpha;
+    };
+
+
+    class PALMPipelineResult
+    {
+    public:
+        PALMPipelineResult();
+        virtual ~PALMPipelineResult() { };
+
+        long long frameId;
+        bool dropped;
+        bool failed; // A stage or the sink threw; the future of the frame holds the exception
+        std::string error;
+        cv::Mat descriptor;
+        cv::Mat patternImage;
+        double latency; // Milliseconds between submission and completion
+    };
+
+
+    // Runs conversion, pattern extraction, histogram building and the sink (database query/insert) on separate
+    // threads connected by lock-free bounded queues, so throughput is bounded by the slowest stage.
+    class PALMPipeline
+    {
+    public:
+        typedef std::function<void(PALMPipelineResult &result)> Sink;
+        typedef std::function<void(const PALMPipelineResult &result)> Callback;
+
+        PALMPipeline(PALMConfig config, PALMPipelineConfig pipelineConfig = PALMPipelineConfig());
+        virtual ~PALMPipeline();
+
+        PALMPipelineConfig getPipelineConfig() const { return _pipelineConfig; }
+
+        void setSink(Sink sink);
+
+        // The callback receives every frame once, also a dropped or failed one. Calls are serialized but come from
+        // the stage threads or, for frames dropped on submission, from submit(), so the callback must not call
+        // stop(). An exception thrown by the callback is passed to the future of the frame.
+        void setCallback(Callback callback);
+
+        void start();
+        void stop();
+        bool isRunning() const { return _running; }
+
+        // Submitting to a stopped pipeline throws; frames submitted before stop() are completed before it returns
+        std::future<PALMPipelineResult> submit(const cv::Mat &image);
+
+        long long submittedCount() const { return _submitted; }
+        long long completedCount() const { return _completed; }
+        long long droppedCount() const { return _dropped; }
+
+    protected:
+        enum Stage
+        {
+            ConvertStage,
+            ExtractStage,
+            HistogramStage,
+            SinkStage,
+            StageCount
+        };
+
+        struct Frame
+        {
+            long long id;
+            cv::Mat image;
+            cv::Mat patterns;
+            cv::Mat descriptor;
+            int64 submitTick;
+            std::promise<PALMPipelineResult> promise;
+        };
+
+        virtual cv::Mat convert(const cv::Mat &image);
+        virtual void process(Stage stage, Frame *frame);
+
+    private:
+        PALMPipelineConfig _pipelineConfig;
+        cv::Ptr<PALM> _PALM;
+        cv::Ptr<IlluminationFilter> _IlluminationFilter;
+
+        Sink _sink;
+        Callback _callback;
+
+        // Wakes a stage that sleeps on its empty queue; producers only take the mutex when the stage sleeps
+        struct StageSignal
+        {
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::atomic<bool> sleeping;
+        };
+
+        std::unique_ptr<BoundedQueue<Frame *>> _Queues[StageCount];
+        StageSignal _Signals[StageCount];
+        std::thread _Threads[StageCount];
+        std::atomic<bool> _finished[StageCount];
+        std::atomic<bool> _running;
+        std::atomic<int> _submitting; // submit() calls that may still enqueue a frame
+        std::mutex _StopMutex;
+        std::mutex _CallbackMutex;
+
+        std::atomic<long long> _submitted;
+        std::atomic<long long> _completed;
+        std::atomic<long long> _dropped;
+
+        void run(Stage stage);
+        bool upstreamFinished(Stage stage) const;
+        void waitForFrames(Stage stage);
+        void wake(Stage stage);
+        bool enqueue(Stage stage, Frame *frame);
+        void complete(Frame *frame, bool dropped);
+        void fail(Frame *frame, std::exception_ptr error);
+        void deliver(Frame *frame, const PALMPipelineResult &result, std::exception_ptr error);
+    };
+}
+
+#endif //PALM_PALMPIPELINE_H
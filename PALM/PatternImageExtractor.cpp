@@ -1,4 +1,6 @@
 #include "PatternImageExtractor.h"
+#include "ApproximatedFilters.h"
+#include "Kernels.h"
 
 using namespace palm;
 
@@ -25,6 +27,14 @@ PatternImageExtractor *PatternImageExtractor::create(FilterType filterType, int
         case FilterType::Approximated:
             instance = new ApproximatedPatternImageExtractor(patchSize, stepSize, momentOrder);
             break;
+
+        case FilterType::ApproximatedIntegral:
+            instance = new IntegralPatternImageExtractor(patchSize, stepSize, momentOrder);
+            break;
+
+        case FilterType::ApproximatedSliding:
+            instance = new SlidingPatternImageExtractor(patchSize, stepSize, momentOrder);
+            break;
     }
 
     return instance;
@@ -53,7 +63,7 @@ int PatternImageExtractor::getOverlapDensity() const
 
 void PatternImageExtractor::setMomentOrder(int momentOrder)
 {
-    CV_Assert(momentOrder > 0 && momentOrder < 4);
+    CV_Assert(momentOrder > 0 && momentOrder <= MAX_MOMENT_ORDER);
 
     _momentOrder = momentOrder;
 }
@@ -68,7 +78,38 @@ std::vector<cv::Mat> PatternImageExtractor::filters() const
     return _Filters;
 }
 
-cv::Mat PatternImageExtractor::extract(const cv::Mat &image)
+int PatternImageExtractor::patternDepth() const
+{
+    return _Filters.size() <= 8 ? CV_8U : CV_16U;
+}
+
+cv::Size PatternImageExtractor::patternSize(cv::Size imageSize) const
+{
+    return cv::Size((imageSize.width - _patchSize) / _stepSize + 1, (imageSize.height - _patchSize) / _stepSize + 1);
+}
+
+cv::Mat PatternImageExtractor::patternMask(const cv::Mat &mask) const
+{
+    CV_Assert(!mask.empty() && mask.type() == CV_8U);
+
+    cv::Size size = patternSize(mask.size());
+    cv::Mat patternMask(size, CV_8U);
+
+    for (int i = 0; i < size.height; i++)
+    {
+        const uchar *maskRow = mask.ptr<uchar>(std::min(i * _stepSize + _patchSize / 2, mask.rows - 1));
+        uchar *out = patternMask.ptr<uchar>(i);
+
+        for (int j = 0; j < size.width; j++)
+        {
+            out[j] = maskRow[std::min(j * _stepSize + _patchSize / 2, mask.cols - 1)] != 0 ? 255 : 0;
+        }
+    }
+
+    return patternMask;
+}
+
+cv::Mat PatternImageExtractor::extract(const cv::Mat &image, const cv::Mat &patternMask)
 {
     CV_Assert(!image.empty());
     CV_Assert(image.channels() == 1);
@@ -77,12 +118,12 @@ cv::Mat PatternImageExtractor::extract(const cv::Mat &image)
     cv::Mat input;
     image.convertTo(input, CV_64F);
 
-    return compute(input, _patchSize, _stepSize, _Filters);
+    return compute(input, _patchSize, _stepSize, _Filters, patternMask);
 }
 
-uchar PatternImageExtractor::applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters)
+ushort PatternImageExtractor::applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters)
 {
-    uchar value = 0;
+    ushort value = 0;
     for (int k = 0; k < filters.size(); k++)
     {
         double sum = 0;
@@ -94,26 +135,40 @@ uchar PatternImageExtractor::applyFilters(int patchSize, const cv::Mat &src, con
             }
         }
 
-        value |= (uchar) (sum > 0) << k;
+        value |= (ushort) (sum > 0) << k;
     }
 
     return value;
 }
 
-cv::Mat PatternImageExtractor::compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters)
+cv::Mat PatternImageExtractor::compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters,
+                                       const cv::Mat &patternMask)
 {
     int rows = (input.rows - patchSize) / stepSize + 1;
     int cols = (input.cols - patchSize) / stepSize + 1;
+    CV_Assert(patternMask.empty() || (patternMask.type() == CV_8U && patternMask.size() == cv::Size(cols, rows)));
 
-    cv::Mat patterns = cv::Mat::zeros(rows, cols, CV_8U);
+    cv::Mat patterns = cv::Mat::zeros(rows, cols, patternDepth());
 
     for (int i = 0; i < patterns.rows; i++)
     {
         for (int j = 0; j < patterns.cols; j++)
         {
+            if (!patternMask.empty() && patternMask.at<uchar>(i, j) == 0)
+            {
+                continue;
+            }
+
             cv::Mat src = input(cv::Rect(j * stepSize, i * stepSize, patchSize, patchSize));
 
-            patterns.at<uchar>(i, j) = applyFilters(patchSize, src, filters);
+            if (patterns.depth() == CV_8U)
+            {
+                patterns.at<uchar>(i, j) = (uchar) applyFilters(patchSize, src, filters);
+            }
+            else
+            {
+                patterns.at<ushort>(i, j) = applyFilters(patchSize, src, filters);
+            }
         }
     }
 
@@ -146,6 +201,37 @@ std::vector<cv::Mat> PatternImageExtractor::createFilters(const cv::Ptr<ZernikeB
     return filters;
 }
 
+void PatternImageExtractor::createCoreFilters(int coreSize, int momentOrder)
+{
+    CV_Assert(coreSize == 4);
+
+    // The first filters are hand-typed in applyApproximatedFilters, the others are evaluated from their cores
+    cv::Ptr<ZernikeBaseGenerator> coreGenerator = new ZernikeBaseGenerator(coreSize);
+    std::vector<cv::Mat> cores = createFilters(coreGenerator, momentOrder);
+
+    _CoreFilters.clear();
+    for (size_t k = APPROXIMATED_FILTER_COUNT; k < cores.size(); k++)
+    {
+        for (int i = 0; i < coreSize; i++)
+        {
+            for (int j = 0; j < coreSize; j++)
+            {
+                _CoreFilters.push_back(cores[k].at<double>(i, j));
+            }
+        }
+    }
+}
+
+ushort PatternImageExtractor::applyCoreFilters(const double v[4][4]) const
+{
+    ushort value = applyApproximatedFilters(v, std::min(getMomentOrder(), 3));
+
+    int count = (int) _CoreFilters.size() / 16;
+    value |= palm::applyCoreFilters(v, _CoreFilters.data(), count, APPROXIMATED_FILTER_COUNT);
+
+    return value;
+}
+
 
 RegularPatternImageExtractor::RegularPatternImageExtractor(int patchSize, int stepSize, int momentOrder)
         : PatternImageExtractor(FilterType::Regular, patchSize, stepSize, momentOrder)
@@ -156,15 +242,38 @@ RegularPatternImageExtractor::RegularPatternImageExtractor(int patchSize, int st
 
 
 ApproximatedPatternImageExtractor::ApproximatedPatternImageExtractor(int patchSize, int stepSize, int momentOrder)
-        : PatternImageExtractor(FilterType::Approximated, patchSize, stepSize, momentOrder)
+        : ApproximatedPatternImageExtractor(FilterType::Approximated, patchSize, stepSize, momentOrder)
+{
+}
+
+ApproximatedPatternImageExtractor::ApproximatedPatternImageExtractor(FilterType filterType, int patchSize, int stepSize,
+                                                                     int momentOrder)
+        : PatternImageExtractor(filterType, patchSize, stepSize, momentOrder)
 {
     int overlapDensity = getOverlapDensity(); // Assert if overlap density could not calculated correctly
 
     cv::Ptr<ZernikeBaseGenerator> baseGenerator = new ApproximatedZernikeBaseGenerator(patchSize, FILTER_CORE_SIZE);
     _Filters = createFilters(baseGenerator, momentOrder);
+    createCoreFilters(FILTER_CORE_SIZE, momentOrder);
 }
 
-cv::Mat ApproximatedPatternImageExtractor::extract(const cv::Mat &image)
+cv::Size ApproximatedPatternImageExtractor::patternSize(cv::Size imageSize) const
+{
+    // Size of the area-averaged image as produced by cv::resize, then the cores that fit into it
+    int patch = getPatchSize() / FILTER_CORE_SIZE;
+    int step = getStepSize() / patch;
+
+    cv::Size values(cvRound(imageSize.width * (1.0 / patch)), cvRound(imageSize.height * (1.0 / patch)));
+
+    return cv::Size((values.width - FILTER_CORE_SIZE) / step + 1, (values.height - FILTER_CORE_SIZE) / step + 1);
+}
+
+cv::Mat ApproximatedPatternImageExtractor::extract(const cv::Mat &image, const cv::Mat &patternMask)
+{
+    return extractDownsampled(downsample(image), patternMask);
+}
+
+cv::Mat ApproximatedPatternImageExtractor::downsample(const cv::Mat &image) const
 {
     CV_Assert(!image.empty());
     CV_Assert(image.channels() == 1);
@@ -173,20 +282,26 @@ cv::Mat ApproximatedPatternImageExtractor::extract(const cv::Mat &image)
     cv::Mat input;
     image.convertTo(input, CV_64F);
 
-    int patchSize = getPatchSize();
-    int stepSize = getStepSize();
-
-    int patch = patchSize / FILTER_CORE_SIZE;
-    int step = stepSize / patch;
+    int patch = getPatchSize() / FILTER_CORE_SIZE;
 
     cv::Mat values;
     cv::resize(input, values, cv::Size(), 1.0 / patch, 1.0 / patch, cv::INTER_AREA);
 
-    return compute(values, FILTER_CORE_SIZE, step, _Filters);
+    return values;
+}
+
+cv::Mat ApproximatedPatternImageExtractor::extractDownsampled(const cv::Mat &values, const cv::Mat &patternMask)
+{
+    CV_Assert(!values.empty() && values.type() == CV_64F);
+
+    int patch = getPatchSize() / FILTER_CORE_SIZE;
+    int step = getStepSize() / patch;
+
+    return compute(values, FILTER_CORE_SIZE, step, _Filters, patternMask);
 }
 
-uchar ApproximatedPatternImageExtractor::applyFilters(int patchSize, const cv::Mat &src,
-                                                      const std::vector<cv::Mat> &filters)
+ushort ApproximatedPatternImageExtractor::applyFilters(int patchSize, const cv::Mat &src,
+                                                       const std::vector<cv::Mat> &filters)
 {
     double v[FILTER_CORE_SIZE][FILTER_CORE_SIZE];
     for (int i = 0; i < FILTER_CORE_SIZE; i++)
@@ -197,71 +312,245 @@ uchar ApproximatedPatternImageExtractor::applyFilters(int patchSize, const cv::M
         }
     }
 
-    int momentOrder = getMomentOrder();
+    return applyCoreFilters(v);
+}
 
-    // Manually typed filter values for speed performance
-    const double C_333 = 0.333333;
-    const double C_111 = 0.111111;
-    const double C_569 = 0.568627;
-    const double C_294 = 0.294118;
-    const double C_481 = 0.481481;
-    const double C_037 = 0.037037;
+cv::Mat ApproximatedPatternImageExtractor::compute(const cv::Mat &input, int patchSize, int stepSize,
+                                                   std::vector<cv::Mat> filters, const cv::Mat &patternMask)
+{
+    CV_Assert(input.type() == CV_64F && patchSize == FILTER_CORE_SIZE);
+
+    int rows = (input.rows - patchSize) / stepSize + 1;
+    int cols = (input.cols - patchSize) / stepSize + 1;
+    CV_Assert(patternMask.empty() || (patternMask.type() == CV_8U && patternMask.size() == cv::Size(cols, rows)));
 
-    uchar value = 0;
+    cv::Mat patterns = cv::Mat::zeros(rows, cols, patternDepth());
+    const uchar *mask = patternMask.empty() ? nullptr : patternMask.ptr<uchar>(0);
+    size_t maskStride = patternMask.empty() ? 0 : patternMask.step1();
 
-    if (momentOrder > 0)
+    if (patterns.depth() == CV_8U)
     {
-        double v1 = -v[0][0] - v[0][1] * C_333 + v[0][2] * C_333 + v[0][3]
-                    - v[1][0] - v[1][1] * C_333 + v[1][2] * C_333 + v[1][3]
-                    - v[2][0] - v[2][1] * C_333 + v[2][2] * C_333 + v[2][3]
-                    - v[3][0] - v[3][1] * C_333 + v[3][2] * C_333 + v[3][3];
-        value |= (uchar) (v1 > 0) << 0;
-
-        double v2 = v[0][0] + v[0][1] + v[0][2] + v[0][3]
-                    + v[1][0] * C_333 + v[1][1] * C_333 + v[1][2] * C_333 + v[1][3] * C_333
-                    - v[2][0] * C_333 - v[2][1] * C_333 - v[2][2] * C_333 - v[2][3] * C_333
-                    - v[3][0] - v[3][1] - v[3][2] - v[3][3];
-        value |= (uchar) (v2 > 0) << 1;
+        // Dispatched to the variant matching the CPU, see Kernels.h
+        kernels().approximatedPatterns(input.ptr<double>(0), input.step1(), rows, cols, stepSize, getMomentOrder(),
+                                       mask, maskStride, patterns.ptr<uchar>(0), patterns.step1());
+        return patterns;
     }
 
-    if (momentOrder > 1)
+    double v[FILTER_CORE_SIZE][FILTER_CORE_SIZE];
+    for (int r = 0; r < rows; r++)
     {
-        double v3 = -v[0][1] - v[0][2] - v[3][1] - v[3][2] + v[1][0] + v[2][0] + v[1][3] + v[2][3];
-        value |= (uchar) (v3 > 0) << 2;
-
-        double v4 = -v[0][0] - v[0][1] * C_333 + v[0][2] * C_333 + v[0][3]
-                    - v[1][0] * C_333 - v[1][1] * C_111 + v[1][2] * C_111 + v[1][3] * C_333
-                    + v[2][0] * C_333 + v[2][1] * C_111 - v[2][2] * C_111 - v[2][3] * C_333
-                    + v[3][0] + v[3][1] * C_333 - v[3][2] * C_333 - v[3][3];
-        value |= (uchar) (v4 > 0) << 3;
+        ushort *out = patterns.ptr<ushort>(r);
+        for (int c = 0; c < cols; c++)
+        {
+            if (mask != nullptr && mask[r * maskStride + c] == 0)
+            {
+                continue;
+            }
+
+            for (int i = 0; i < FILTER_CORE_SIZE; i++)
+            {
+                const double *row = input.ptr<double>(r * stepSize + i) + c * stepSize;
+                for (int j = 0; j < FILTER_CORE_SIZE; j++)
+                {
+                    v[i][j] = row[j];
+                }
+            }
+
+            out[c] = applyCoreFilters(v);
+        }
     }
 
-    if (momentOrder > 2)
+    return patterns;
+}
+
+
+// Weight of a 4x4 filter on element (a, b) of the mirrored basis, see applyMirroredApproximatedFilters
+static double mirroredWeight(const double *filter, int a, int b)
+{
+    double h[4];
+    for (int i = 0; i < 4; i++)
     {
-        double v5 = v[0][0] * C_294 + v[0][1] * C_333 - v[0][2] * C_333 - v[0][3] * C_294
-                    + v[1][0] + v[1][1] * C_569 - v[1][2] * C_569 - v[1][3]
-                    + v[2][0] + v[2][1] * C_569 - v[2][2] * C_569 - v[2][3]
-                    + v[3][0] * C_294 + v[3][1] * C_333 - v[3][2] * C_333 - v[3][3] * C_294;
-        value |= (uchar) (v5 > 0) << 4;
-
-        double v6 = -v[0][0] * C_294 - v[0][1] - v[0][2] - v[0][3] * C_294
-                    - v[1][0] * C_333 - v[1][1] * C_569 - v[1][2] * C_569 - v[1][3] * C_333
-                    + v[2][0] * C_333 + v[2][1] * C_569 + v[2][2] * C_569 + v[2][3] * C_333
-                    + v[3][0] * C_294 + v[3][1] + v[3][2] + v[3][3] * C_294;
-        value |= (uchar) (v6 > 0) << 5;
-
-        double v7 = v[0][0] + v[0][1] * C_481 - v[0][2] * C_481 - v[0][3]
-                    - v[1][0] * C_333 + v[1][1] * C_037 - v[1][2] * C_037 + v[1][3] * C_333
-                    - v[2][0] * C_333 + v[2][1] * C_037 - v[2][2] * C_037 + v[2][3] * C_333
-                    + v[3][0] + v[3][1] * C_481 - v[3][2] * C_481 - v[3][3];
-        value |= (uchar) (v7 > 0) << 6;
-
-        double v8 = v[0][0] - v[0][1] * C_333 - v[0][2] * C_333 + v[0][3]
-                    + v[1][0] * C_481 + v[1][1] * C_037 + v[1][2] * C_037 + v[1][3] * C_481
-                    - v[2][0] * C_481 - v[2][1] * C_037 - v[2][2] * C_037 - v[2][3] * C_481
-                    - v[3][0] + v[3][1] * C_333 + v[3][2] * C_333 - v[3][3];
-        value |= (uchar) (v8 > 0) << 7;
+        const double *w = filter + 4 * i;
+        h[i] = b == 0 ? (w[0] + w[3]) / 2 : b == 1 ? (w[1] + w[2]) / 2 : b == 2 ? (w[0] - w[3]) / 2 : (w[1] - w[2]) / 2;
     }
 
-    return value;
+    return a == 0 ? (h[0] + h[3]) / 2 : a == 1 ? (h[1] + h[2]) / 2 : a == 2 ? (h[0] - h[3]) / 2 : (h[1] - h[2]) / 2;
+}
+
+
+SlidingPatternImageExtractor::SlidingPatternImageExtractor(int patchSize, int stepSize, int momentOrder)
+        : ApproximatedPatternImageExtractor(FilterType::ApproximatedSliding, patchSize, stepSize, momentOrder)
+{
+}
+
+cv::Mat SlidingPatternImageExtractor::compute(const cv::Mat &input, int patchSize, int stepSize,
+                                              std::vector<cv::Mat> filters, const cv::Mat &patternMask)
+{
+    CV_Assert(input.type() == CV_64F && patchSize == FILTER_CORE_SIZE);
+
+    int rows = (input.rows - patchSize) / stepSize + 1;
+    int cols = (input.cols - patchSize) / stepSize + 1;
+    CV_Assert(patternMask.empty() || (patternMask.type() == CV_8U && patternMask.size() == cv::Size(cols, rows)));
+
+    cv::Mat patterns = cv::Mat::zeros(rows, cols, patternDepth());
+    const uchar *mask = patternMask.empty() ? nullptr : patternMask.ptr<uchar>(0);
+    size_t maskStride = patternMask.empty() ? 0 : patternMask.step1();
+    int coreFilterCount = (int) _CoreFilters.size() / 16;
+
+    double maxWeight = 0;
+    for (double weight : _CoreFilters)
+    {
+        maxWeight = std::max(maxWeight, std::abs(weight));
+    }
+
+    // Mirrored basis weights of the core filters; the hand-typed filters have their own expressions in the kernel.
+    // Sampled filters are symmetric up to rounding, so weights at that level are dropped like exact zeros.
+    std::vector<int> termStart(coreFilterCount + 1);
+    std::vector<int> termBasis;
+    std::vector<double> termWeights;
+    for (int k = 0; k < coreFilterCount; k++)
+    {
+        termStart[k] = (int) termBasis.size();
+        for (int e = 0; e < 16; e++)
+        {
+            double weight = mirroredWeight(_CoreFilters.data() + 16 * k, e / 4, e % 4);
+            if (std::abs(weight) > 1e-15 * std::max(maxWeight, 1.0))
+            {
+                termBasis.push_back(e);
+                termWeights.push_back(weight);
+            }
+        }
+    }
+    termStart[coreFilterCount] = (int) termBasis.size();
+
+    std::vector<double> pairs(slidingPairsSize(cols));
+
+    const KernelTable &kernel = kernels();
+    if (patterns.depth() == CV_8U)
+    {
+        kernel.slidingPatterns(input.ptr<double>(0), input.step1(), rows, cols, stepSize, getMomentOrder(),
+                               _CoreFilters.data(), coreFilterCount, termStart.data(), termBasis.data(),
+                               termWeights.data(), maxWeight, mask, maskStride, pairs.data(), patterns.ptr<uchar>(0),
+                               patterns.step1());
+    }
+    else
+    {
+        kernel.slidingPatterns16(input.ptr<double>(0), input.step1(), rows, cols, stepSize, getMomentOrder(),
+                                 _CoreFilters.data(), coreFilterCount, termStart.data(), termBasis.data(),
+                                 termWeights.data(), maxWeight, mask, maskStride, pairs.data(),
+                                 patterns.ptr<ushort>(0), patterns.step1());
+    }
+
+    return patterns;
+}
+
+
+IntegralPatternImageExtractor::IntegralPatternImageExtractor(int patchSize, int stepSize, int momentOrder)
+        : PatternImageExtractor(FilterType::ApproximatedIntegral, patchSize, stepSize, momentOrder)
+{
+    cv::Ptr<ZernikeBaseGenerator> baseGenerator = new ApproximatedZernikeBaseGenerator(patchSize, FILTER_CORE_SIZE);
+    _Filters = createFilters(baseGenerator, momentOrder);
+    createCoreFilters(FILTER_CORE_SIZE, momentOrder);
+}
+
+cv::Mat IntegralPatternImageExtractor::extract(const cv::Mat &image, const cv::Mat &patternMask)
+{
+    CV_Assert(!image.empty());
+    CV_Assert(image.channels() == 1);
+    CV_Assert(image.rows >= getPatchSize() && image.cols >= getPatchSize());
+
+    cv::Mat integral;
+    if (image.depth() == CV_8U || image.depth() == CV_64F)
+    {
+        cv::integral(image, integral, CV_64F);
+    }
+    else
+    {
+        cv::Mat input;
+        image.convertTo(input, CV_64F);
+        cv::integral(input, integral, CV_64F);
+    }
+
+    return computeIntegral(integral, getPatchSize(), getStepSize(), patternMask);
+}
+
+cv::Mat IntegralPatternImageExtractor::computeIntegral(const cv::Mat &integral, int patchSize, int stepSize,
+                                                       const cv::Mat &patternMask)
+{
+    int rows = (integral.rows - 1 - patchSize) / stepSize + 1;
+    int cols = (integral.cols - 1 - patchSize) / stepSize + 1;
+    CV_Assert(patternMask.empty() || (patternMask.type() == CV_8U && patternMask.size() == cv::Size(cols, rows)));
+
+    cv::Mat patterns = cv::Mat::zeros(rows, cols, patternDepth());
+    bool wideCodes = patterns.depth() == CV_16U;
+
+    // Block boundaries inside a patch; blocks differ by at most one pixel when the patch is not divisible by 4
+    int bounds[FILTER_CORE_SIZE + 1];
+    for (int k = 0; k <= FILTER_CORE_SIZE; k++)
+    {
+        bounds[k] = k * patchSize / FILTER_CORE_SIZE;
+    }
+
+    double inverseArea[FILTER_CORE_SIZE][FILTER_CORE_SIZE];
+    for (int i = 0; i < FILTER_CORE_SIZE; i++)
+    {
+        for (int j = 0; j < FILTER_CORE_SIZE; j++)
+        {
+            inverseArea[i][j] = 1.0 / ((bounds[i + 1] - bounds[i]) * (bounds[j + 1] - bounds[j]));
+        }
+    }
+
+    int momentOrder = getMomentOrder();
+    double corners[FILTER_CORE_SIZE + 1][FILTER_CORE_SIZE + 1];
+    double v[FILTER_CORE_SIZE][FILTER_CORE_SIZE];
+
+    for (int r = 0; r < rows; r++)
+    {
+        const double *cornerRows[FILTER_CORE_SIZE + 1];
+        for (int k = 0; k <= FILTER_CORE_SIZE; k++)
+        {
+            cornerRows[k] = integral.ptr<double>(r * stepSize + bounds[k]);
+        }
+
+        uchar *out = patterns.ptr<uchar>(r);
+        ushort *wideOut = patterns.ptr<ushort>(r);
+        const uchar *valid = patternMask.empty() ? nullptr : patternMask.ptr<uchar>(r);
+
+        for (int c = 0; c < cols; c++)
+        {
+            if (valid != nullptr && valid[c] == 0)
+            {
+                continue;
+            }
+
+            int x = c * stepSize;
+            for (int i = 0; i <= FILTER_CORE_SIZE; i++)
+            {
+                for (int j = 0; j <= FILTER_CORE_SIZE; j++)
+                {
+                    corners[i][j] = cornerRows[i][x + bounds[j]];
+                }
+            }
+
+            for (int i = 0; i < FILTER_CORE_SIZE; i++)
+            {
+                for (int j = 0; j < FILTER_CORE_SIZE; j++)
+                {
+                    double sum = corners[i + 1][j + 1] - corners[i][j + 1] - corners[i + 1][j] + corners[i][j];
+                    v[i][j] = sum * inverseArea[i][j];
+                }
+            }
+
+            if (wideCodes)
+            {
+                wideOut[c] = applyCoreFilters(v);
+            }
+            else
+            {
+                out[c] = applyApproximatedFilters(v, momentOrder);
+            }
+        }
+    }
+
+    return patterns;
 }
\ No newline at end of file
@@ -9,7 +9,9 @@ namespace palm
     enum class FilterType
     {
         Regular,
-        Approximated
+        Approximated,
+        ApproximatedIntegral,
+        ApproximatedSliding
     };
 
 
@@ -21,6 +23,9 @@ namespace palm
 
         static PatternImageExtractor* create(FilterType filterType, int patchSize, int stepSize, int momentOrder);
 
+        // Every filter adds one bit to the pattern code, so order 4 with its 12 filters needs 16-bit codes
+        static const int MAX_MOMENT_ORDER = 4;
+
         int getPatchSize() const { return _patchSize; }
         void setPatchSize(int patchSize);
 
@@ -33,14 +38,24 @@ namespace palm
 
         FilterType filterType() const;
         virtual std::vector<cv::Mat> filters() const;
-        virtual cv::Mat extract(const cv::Mat &image);
+        int patternDepth() const; // CV_8U for up to 8 filters, CV_16U above
+
+        // A pattern is evaluated only where the pattern mask is non-zero, other patterns get code 0. patternMask()
+        // turns an image mask into a pattern mask by sampling it at the patch centers.
+        virtual cv::Size patternSize(cv::Size imageSize) const;
+        cv::Mat patternMask(const cv::Mat &mask) const;
+        virtual cv::Mat extract(const cv::Mat &image, const cv::Mat &patternMask = cv::Mat());
 
     protected:
         std::vector<cv::Mat> _Filters;
+        std::vector<double> _CoreFilters; // 4x4 cores of the approximated filters beyond the hand-typed ones
 
         virtual std::vector<cv::Mat> createFilters(const cv::Ptr<ZernikeBaseGenerator> &baseGenerator, int momentOrder);
-        virtual uchar applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters);
-        virtual cv::Mat compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters);
+        void createCoreFilters(int coreSize, int momentOrder);
+        ushort applyCoreFilters(const double v[4][4]) const;
+        virtual ushort applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters);
+        virtual cv::Mat compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters,
+                                const cv::Mat &patternMask);
 
     private:
         FilterType _filterType;
@@ -69,10 +84,51 @@ namespace palm
 
         static const int FILTER_CORE_SIZE = 4;
 
-        virtual cv::Mat extract(const cv::Mat &image) override;
+        virtual cv::Size patternSize(cv::Size imageSize) const override;
+        virtual cv::Mat extract(const cv::Mat &image, const cv::Mat &patternMask = cv::Mat()) override;
+        virtual cv::Mat downsample(const cv::Mat &image) const;
+        virtual cv::Mat extractDownsampled(const cv::Mat &values, const cv::Mat &patternMask = cv::Mat());
+
+    protected:
+        ApproximatedPatternImageExtractor(FilterType filterType, int patchSize, int stepSize, int momentOrder);
+
+        ushort applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters) override;
+        cv::Mat compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters,
+                        const cv::Mat &patternMask) override;
+
+    private:
+
+    };
+
+
+    // Approximated extractor that computes the column pair sums and differences of every downsampled row once and
+    // shares them between the overlapping cores, which combine them into the mirrored basis the filters are applied
+    // to. Cores with a response near zero are evaluated directly, so the codes are identical to the ones of
+    // ApproximatedPatternImageExtractor; it pays off when the step is smaller than the patch.
+    class SlidingPatternImageExtractor : public ApproximatedPatternImageExtractor
+    {
+    public:
+        SlidingPatternImageExtractor(int patchSize, int stepSize, int momentOrder);
+
+    protected:
+        cv::Mat compute(const cv::Mat &input, int patchSize, int stepSize, std::vector<cv::Mat> filters,
+                        const cv::Mat &patternMask) override;
+    };
+
+
+    // Evaluates the approximated filters on the 4x4 block means of every patch, read from a single integral image of
+    // the input. Unlike ApproximatedPatternImageExtractor it needs no resize and accepts any patch and step size.
+    class IntegralPatternImageExtractor : public PatternImageExtractor
+    {
+    public:
+        IntegralPatternImageExtractor(int patchSize, int stepSize, int momentOrder);
+
+        static const int FILTER_CORE_SIZE = ApproximatedPatternImageExtractor::FILTER_CORE_SIZE;
+
+        virtual cv::Mat extract(const cv::Mat &image, const cv::Mat &patternMask = cv::Mat()) override;
 
     protected:
-        uchar applyFilters(int patchSize, const cv::Mat &src, const std::vector<cv::Mat> &filters) override;
+        cv::Mat computeIntegral(const cv::Mat &integral, int patchSize, int stepSize, const cv::Mat &patternMask);
 
     private:
 
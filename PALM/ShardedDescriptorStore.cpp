@@ -0,0 +1,276 @@
+#include "ShardedDescriptorStore.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace palm;
+
+
+ShardedDescriptorStoreConfig::ShardedDescriptorStoreConfig()
+{
+    shardCount = 0;
+    shardingPolicy = ShardingPolicy::InsertionRange;
+    rangeSize = 1024;
+    pinWorkers = true;
+}
+
+
+ShardedDescriptorStore::ShardedDescriptorStore(int descriptorSize, int cellLength, ShardedDescriptorStoreConfig config)
+        : _config(config), _descriptorSize(descriptorSize), _Distance(descriptorSize, cellLength), _size(0)
+{
+    CV_Assert(config.shardCount >= 0 && config.rangeSize > 0);
+
+    int shardCount = config.shardCount;
+    if (shardCount == 0)
+    {
+        shardCount = std::max(1, (int) std::thread::hardware_concurrency());
+    }
+
+    for (int s = 0; s < shardCount; s++)
+    {
+        std::unique_ptr<Shard> shard(new Shard());
+        shard->count = 0;
+        shard->stopping = false;
+        _Shards.push_back(std::move(shard));
+    }
+
+    for (int s = 0; s < shardCount; s++)
+    {
+        _Shards[s]->worker = std::thread(&ShardedDescriptorStore::run, this, s);
+    }
+
+    // Workers are pinned before any task is posted, so each shard is first touched from its worker's CPU
+    if (_config.pinWorkers)
+    {
+        _config.pinWorkers = pinWorkers();
+    }
+}
+
+bool ShardedDescriptorStore::pinWorkers()
+{
+#ifdef __linux__
+    // Only the CPUs this process may run on, which can be fewer than the hardware threads (cpusets, taskset)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return false;
+    }
+
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty())
+    {
+        return false;
+    }
+
+    bool pinned = true;
+    for (size_t s = 0; s < _Shards.size(); s++)
+    {
+        cpu_set_t worker;
+        CPU_ZERO(&worker);
+        CPU_SET(cpus[s % cpus.size()], &worker);
+
+        pinned &= pthread_setaffinity_np(_Shards[s]->worker.native_handle(), sizeof(worker), &worker) == 0;
+    }
+
+    return pinned;
+#else
+    return false;
+#endif
+}
+
+ShardedDescriptorStore::~ShardedDescriptorStore()
+{
+    for (size_t s = 0; s < _Shards.size(); s++)
+    {
+        Shard &shard = *_Shards[s];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.stopping = true;
+        }
+        shard.condition.notify_one();
+    }
+
+    for (size_t s = 0; s < _Shards.size(); s++)
+    {
+        _Shards[s]->worker.join();
+    }
+}
+
+int ShardedDescriptorStore::shardSize(int shard) const
+{
+    CV_Assert(shard >= 0 && shard < shardCount());
+
+    return _Shards[shard]->count.load();
+}
+
+int ShardedDescriptorStore::selectShard(int index, long long spatialKey) const
+{
+    int shardCount = this->shardCount();
+
+    switch (_config.shardingPolicy)
+    {
+        case ShardingPolicy::RoundRobin:
+            return index % shardCount;
+
+        case ShardingPolicy::SpatialKey:
+            return (int) (std::hash<long long>()(spatialKey) % (size_t) shardCount);
+
+        case ShardingPolicy::InsertionRange:
+        default:
+            return (index / _config.rangeSize) % shardCount;
+    }
+}
+
+int ShardedDescriptorStore::add(const cv::Mat &descriptor, long long spatialKey)
+{
+    CV_Assert(descriptor.type() == CV_64F && descriptor.rows == 1 && descriptor.cols == _descriptorSize);
+
+    int index = _size++;
+    Shard &shard = *_Shards[selectShard(index, spatialKey)];
+
+    // The owning worker copies the descriptor, so the shard memory is allocated and touched on its core
+    cv::Mat copy = descriptor.clone();
+    post(shard, [&shard, copy, index]()
+    {
+        try
+        {
+            const double *data = copy.ptr<double>(0);
+            shard.descriptors.insert(shard.descriptors.end(), data, data + copy.cols);
+            shard.indices.push_back(index);
+            shard.count++;
+        }
+        catch (...)
+        {
+            // Nobody waits for an add, so the error is kept for the searches of this shard
+            if (!shard.failure)
+            {
+                shard.failure = std::current_exception();
+            }
+        }
+    });
+
+    return index;
+}
+
+std::vector<DescriptorMatch> ShardedDescriptorStore::search(const cv::Mat &query, int k)
+{
+    CV_Assert(k > 0);
+    CV_Assert(query.type() == CV_64F && query.rows == 1 && query.cols == _descriptorSize);
+
+    int shardCount = this->shardCount();
+    std::vector<std::vector<DescriptorMatch>> results((size_t) shardCount);
+    std::vector<std::future<void>> done;
+
+    // The k-th best distance of any shard bounds the global k-th best, so shards share the tightest one
+    std::atomic<double> sharedBound(std::numeric_limits<double>::infinity());
+
+    const double *q = query.ptr<double>(0);
+    int descriptorSize = _descriptorSize;
+    const BoundedL1Distance &distance = _Distance;
+
+    for (int s = 0; s < shardCount; s++)
+    {
+        Shard &shard = *_Shards[s];
+        std::vector<DescriptorMatch> &result = results[s];
+
+        done.push_back(post(shard, [&, q, descriptorSize]()
+        {
+            if (shard.failure)
+            {
+                std::rethrow_exception(shard.failure);
+            }
+
+            TopMatches matches(k);
+
+            int count = shard.count.load();
+            for (int i = 0; i < count; i++)
+            {
+                double bound = std::min(matches.bound(), sharedBound.load(std::memory_order_relaxed));
+                double d = distance.compute(q, &shard.descriptors[(size_t) i * descriptorSize], bound);
+
+                if (d <= bound && matches.push(shard.indices[i], d) && matches.bound() < bound)
+                {
+                    double current = sharedBound.load(std::memory_order_relaxed);
+                    while (matches.bound() < current &&
+                           !sharedBound.compare_exchange_weak(current, matches.bound(), std::memory_order_relaxed))
+                    {
+                    }
+                }
+            }
+
+            result = matches.sorted();
+        }));
+    }
+
+    // Every task refers to this frame, so all of them must finish before an exception leaves it
+    for (int s = 0; s < shardCount; s++)
+    {
+        done[s].wait();
+    }
+    for (int s = 0; s < shardCount; s++)
+    {
+        done[s].get();
+    }
+
+    TopMatches merged(k);
+    for (int s = 0; s < shardCount; s++)
+    {
+        for (size_t i = 0; i < results[s].size(); i++)
+        {
+            merged.push(results[s][i].index, results[s][i].distance);
+        }
+    }
+
+    return merged.sorted();
+}
+
+std::future<void> ShardedDescriptorStore::post(Shard &shard, std::function<void()> task)
+{
+    // The packaged task passes an exception to its future instead of letting it escape the worker
+    std::shared_ptr<std::packaged_task<void()>> packaged = std::make_shared<std::packaged_task<void()>>(task);
+    std::future<void> result = packaged->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.tasks.push_back([packaged]() { (*packaged)(); });
+    }
+
+    shard.condition.notify_one();
+
+    return result;
+}
+
+void ShardedDescriptorStore::run(int shardIndex)
+{
+    Shard &shard = *_Shards[shardIndex];
+
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.condition.wait(lock, [&shard]() { return shard.stopping || !shard.tasks.empty(); });
+
+            if (shard.tasks.empty())
+            {
+                break; // Stopping and drained
+            }
+
+            task = std::move(shard.tasks.front());
+            shard.tasks.pop_front();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef PALM_SHARDEDDESCRIPTORSTORE_H
+#define PALM_SHARDEDDESCRIPTORSTORE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "BoundedL1Distance.h"
+
+
+namespace palm
+{
+    enum class ShardingPolicy
+    {
+        InsertionRange, // Consecutive blocks of rangeSize descriptors go to the same shard
+        RoundRobin,     // Descriptor i goes to shard i % shardCount
+        SpatialKey      // Descriptors with the same spatial key share a shard
+    };
+
+
+    class ShardedDescriptorStoreConfig
+    {
+    public:
+        ShardedDescriptorStoreConfig();
+        virtual ~ShardedDescriptorStoreConfig() { };
+
+        int shardCount; // 0 uses one shard per hardware thread
+        ShardingPolicy shardingPolicy;
+        int rangeSize;
+        bool pinWorkers; // Cleared in the store's configuration when the workers could not be pinned
+    };
+
+
+    // Descriptor store split into shards, each owned by one worker thread. A worker appends to and scans only its own
+    // shard. Workers are pinned to the CPUs the process may use, so the shard memory is first touched by a fixed CPU;
+    // placement on its memory node relies on the kernel's first-touch policy, no NUMA API is used.
+    // Queries fan out to every shard and the per-shard top-k lists are merged.
+    class ShardedDescriptorStore
+    {
+    public:
+        ShardedDescriptorStore(int descriptorSize, int cellLength,
+                               ShardedDescriptorStoreConfig config = ShardedDescriptorStoreConfig());
+        virtual ~ShardedDescriptorStore();
+
+        ShardedDescriptorStoreConfig getConfig() const { return _config; }
+        int descriptorSize() const { return _descriptorSize; }
+        int shardCount() const { return (int) _Shards.size(); }
+        int size() const { return _size; }
+        int shardSize(int shard) const;
+
+        // Returns the global index of the descriptor. The shard worker stores it later; if that fails, every following
+        // search() throws the error.
+        virtual int add(const cv::Mat &descriptor, long long spatialKey = 0);
+
+        // Rethrows an exception of any shard task once every shard has finished the query
+        virtual std::vector<DescriptorMatch> search(const cv::Mat &query, int k);
+
+    protected:
+        struct Shard
+        {
+            std::vector<double> descriptors;
+            std::vector<int> indices;
+            std::atomic<int> count;
+
+            std::thread worker;
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::deque<std::function<void()>> tasks;
+            bool stopping;
+
+            std::exception_ptr failure; // First failed add, only accessed by the worker
+        };
+
+        virtual int selectShard(int index, long long spatialKey) const;
+        std::future<void> post(Shard &shard, std::function<void()> task);
+        void run(int shard);
+        bool pinWorkers();
+
+    private:
+        ShardedDescriptorStoreConfig _config;
+        int _descriptorSize;
+        BoundedL1Distance _Distance;
+        std::vector<std::unique_ptr<Shard>> _Shards;
+        std::atomic<int> _size;
+    };
+}
+
+#endif //PALM_SHARDEDDESCRIPTORSTORE_H
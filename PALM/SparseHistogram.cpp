@@ -0,0 +1,148 @@
+#include "SparseHistogram.h"
+
+using namespace palm;
+
+
+SparseHistogram::SparseHistogram()
+        : _cellCount(0), _binCount(0)
+{
+    _CellOffsets.push_back(0);
+}
+
+SparseHistogram::SparseHistogram(int binCount)
+        : _cellCount(0), _binCount(binCount)
+{
+    CV_Assert(binCount > 1);
+
+    _CellOffsets.push_back(0);
+}
+
+SparseHistogram SparseHistogram::fromDense(const cv::Mat &histogram, int binCount)
+{
+    CV_Assert(histogram.type() == CV_64F && histogram.rows == 1);
+    CV_Assert(binCount > 1 && histogram.cols % binCount == 0);
+
+    SparseHistogram sparse(binCount);
+
+    std::vector<int> bins;
+    std::vector<double> values;
+
+    const double *data = histogram.ptr<double>(0);
+    for (int cell = 0; cell < histogram.cols / binCount; cell++)
+    {
+        bins.clear();
+        values.clear();
+
+        for (int bin = 0; bin < binCount; bin++)
+        {
+            double value = data[cell * binCount + bin];
+            if (value != 0)
+            {
+                bins.push_back(bin);
+                values.push_back(value);
+            }
+        }
+
+        sparse.appendCell(bins.data(), values.data(), (int) bins.size());
+    }
+
+    return sparse;
+}
+
+int SparseHistogram::cellNonZeroCount(int cell) const
+{
+    CV_Assert(cell >= 0 && cell < _cellCount);
+
+    return _CellOffsets[cell + 1] - _CellOffsets[cell];
+}
+
+const int *SparseHistogram::cellBins(int cell) const
+{
+    CV_Assert(cell >= 0 && cell < _cellCount);
+
+    return _Bins.data() + _CellOffsets[cell];
+}
+
+const double *SparseHistogram::cellValues(int cell) const
+{
+    CV_Assert(cell >= 0 && cell < _cellCount);
+
+    return _Values.data() + _CellOffsets[cell];
+}
+
+void SparseHistogram::appendCell(const int *bins, const double *values, int count)
+{
+    CV_Assert(_binCount > 1 && count >= 0 && count <= _binCount);
+
+    for (int k = 0; k < count; k++)
+    {
+        CV_Assert(bins[k] >= 0 && bins[k] < _binCount);
+        CV_Assert(k == 0 || bins[k - 1] < bins[k]);
+
+        _Bins.push_back(bins[k]);
+        _Values.push_back(values[k]);
+    }
+
+    _CellOffsets.push_back((int) _Values.size());
+    _cellCount++;
+}
+
+cv::Mat SparseHistogram::toDense() const
+{
+    CV_Assert(!empty());
+
+    cv::Mat histogram = cv::Mat::zeros(1, length(), CV_64F);
+    double *data = histogram.ptr<double>(0);
+
+    for (int cell = 0; cell < _cellCount; cell++)
+    {
+        for (int k = _CellOffsets[cell]; k < _CellOffsets[cell + 1]; k++)
+        {
+            data[cell * _binCount + _Bins[k]] = _Values[k];
+        }
+    }
+
+    return histogram;
+}
+
+double SparseHistogram::distance(const SparseHistogram &hist1, const SparseHistogram &hist2)
+{
+    CV_Assert(!hist1.empty() && !hist2.empty());
+    CV_Assert(hist1._cellCount == hist2._cellCount && hist1._binCount == hist2._binCount);
+
+    // Merge the sorted bins of each cell; a bin missing on one side contributes its absolute value
+    double sum = 0;
+    for (int cell = 0; cell < hist1._cellCount; cell++)
+    {
+        int a = hist1._CellOffsets[cell], aEnd = hist1._CellOffsets[cell + 1];
+        int b = hist2._CellOffsets[cell], bEnd = hist2._CellOffsets[cell + 1];
+
+        while (a < aEnd && b < bEnd)
+        {
+            if (hist1._Bins[a] == hist2._Bins[b])
+            {
+                sum += std::abs(hist1._Values[a++] - hist2._Values[b++]);
+            }
+            else if (hist1._Bins[a] < hist2._Bins[b])
+            {
+                sum += std::abs(hist1._Values[a++]);
+            }
+            else
+            {
+                sum += std::abs(hist2._Values[b++]);
+            }
+        }
+
+        while (a < aEnd)
+        {
+            sum += std::abs(hist1._Values[a++]);
+        }
+
+        while (b < bEnd)
+        {
+            sum += std::abs(hist2._Values[b++]);
+        }
+    }
+
+    return sum;
+}
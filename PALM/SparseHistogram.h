@@ -0,0 +1,43 @@
+#ifndef PALM_SPARSEHISTOGRAM_H
+#define PALM_SPARSEHISTOGRAM_H
+
+#include <opencv2/core.hpp>
+
+
+namespace palm
+{
+    // Sparse form of a PALM descriptor: every cell keeps only its populated bins as sorted (bin, value) pairs
+    class SparseHistogram
+    {
+    public:
+        SparseHistogram();
+        SparseHistogram(int binCount);
+        virtual ~SparseHistogram() { };
+
+        static SparseHistogram fromDense(const cv::Mat &histogram, int binCount);
+
+        int cellCount() const { return _cellCount; }
+        int binCount() const { return _binCount; }
+        int length() const { return _cellCount * _binCount; }
+        int nonZeroCount() const { return (int) _Values.size(); }
+        bool empty() const { return _cellCount == 0; }
+
+        int cellNonZeroCount(int cell) const;
+        const int *cellBins(int cell) const;
+        const double *cellValues(int cell) const;
+
+        void appendCell(const int *bins, const double *values, int count);
+        cv::Mat toDense() const;
+
+        static double distance(const SparseHistogram &hist1, const SparseHistogram &hist2);
+
+    private:
+        int _cellCount;
+        int _binCount;
+        std::vector<int> _CellOffsets;
+        std::vector<int> _Bins;
+        std::vector<double> _Values;
+    };
+}
+
+#endif //PALM_SPARSEHISTOGRAM_H
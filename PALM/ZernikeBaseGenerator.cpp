@@ -57,16 +57,30 @@ bool ZernikeBaseGenerator::nmRelation(int n, int m)
     return m_ <= n && (n - m_) % 2 == 0;
 }
 
-double ZernikeBaseGenerator::factorial(int x)
+double ZernikeBaseGenerator::radial(int n, int m, double rho)
 {
-    double result = 1.0;
-    while (x > 0)
+    // Kintner's recurrence over n for a fixed m; unlike the factorial series it stays accurate at high orders
+    double rho2 = rho * rho;
+    double previous = std::pow(rho, m); // R(m, m)
+    if (n == m)
     {
-        result = result * x;
-        x--;
+        return previous;
     }
 
-    return result;
+    double current = (m + 2) * previous * rho2 - (m + 1) * previous; // R(m + 2, m)
+    for (int k = m + 4; k <= n; k += 2)
+    {
+        double k1 = (k + m) * (k - m) * (k - 2) / 2.0;
+        double k2 = 2.0 * k * (k - 1) * (k - 2);
+        double k3 = -m * m * (k - 1) - k * (k - 1) * (k - 2);
+        double k4 = -k * (k + m - 2) * (k - m - 2) / 2.0;
+
+        double next = ((k2 * rho2 + k3) * current + k4 * previous) / k1;
+        previous = current;
+        current = next;
+    }
+
+    return current;
 }
 
 void ZernikeBaseGenerator::compute(int n, int m, int size, cv::Mat &reel, cv::Mat &imag)
@@ -78,35 +92,26 @@ void ZernikeBaseGenerator::compute(int n, int m, int size, cv::Mat &reel, cv::Ma
     {
         for (int x = 0; x < size; x++)
         {
-            std::complex<double> value;
-
             double D = size * std::sqrt(2.);
             double xn = (2. * x + 1. - size) / D;
             double yn = (2. * y + 1. - size) / D;
 
-            for (int s = 0; s <= (n - m) / 2; s++)
+            // theta must be between the range of (0,2PI)
+            double theta = std::atan2(yn, xn);
+            if (theta < 0)
             {
-                // theta must be between the range of (0,2PI)
-                double theta = std::atan2(yn, xn);
-                if (theta < 0)
-                {
-                    theta = 2 * M_PI + theta;
-                }
-
-                value += (pow(-1., (double) s)) * (factorial(n - s)) /
-                         (factorial(s) * (factorial((n - 2 * s + m) / 2)) *
-                          (factorial((n - 2 * s - m) / 2))) *
-                         (pow(sqrt(xn * xn + yn * yn), (n - 2. * s))) *
-                         4. / (D * D) * std::polar(1., m * theta);
+                theta = 2 * M_PI + theta;
             }
 
+            std::complex<double> value = radial(n, m, std::sqrt(xn * xn + yn * yn)) * 4. / (D * D) *
+                                         std::polar(1., m * theta);
+
             reel.at<double>(y, x) = std::real(std::conj(value));
             imag.at<double>(y, x) = std::imag(std::conj(value));
         }
     }
 }
 
-
 ApproximatedZernikeBaseGenerator::ApproximatedZernikeBaseGenerator(int size, int coreSize)
         : ZernikeBaseGenerator(size)
 {
@@ -37,7 +37,7 @@ namespace palm
 
     protected:
         bool nmRelation(int n, int m);
-        double factorial(int x);
+        double radial(int n, int m, double rho);
         void compute(int n, int m, int size, cv::Mat &reel, cv::Mat &imag);
 
     private:
@@ -0,0 +1,136 @@
+#include <cstring>
+#include <iostream>
+#include "CpuFeatures.h"
+#include "Kernels.h"
+#include "PALM.h"
+
+// Checks that the alternative code paths of PALM give exactly the results of the reference paths. Run through ctest;
+// every check throws a cv::Exception on the first mismatch.
+
+using namespace palm;
+
+static bool equal(const cv::Mat &a, const cv::Mat &b)
+{
+    return a.size() == b.size() && a.type() == b.type() && cv::countNonZero(a != b) == 0;
+}
+
+static cv::Mat randomCodes(cv::RNG &rng, cv::Size size, int depth, int codeBits)
+{
+    cv::Mat codes(size, depth);
+    rng.fill(codes, cv::RNG::UNIFORM, 0, 1 << codeBits);
+
+    return codes;
+}
+
+static cv::Mat randomMask(cv::RNG &rng, cv::Size size)
+{
+    cv::Mat mask(size, CV_8U);
+    rng.fill(mask, cv::RNG::UNIFORM, 0, 4);
+
+    return mask;
+}
+
+// The sparse histogram holds the same values as the dense one, bit for bit
+static void checkSparseHistogram()
+{
+    cv::RNG rng(1);
+    cv::Size size(157, 121);
+
+    HistogramBuilder single(cv::Size(5, 5), 256, true);
+    HistogramBuilder grouped(cv::Size(4, 3), 12, 6, true);
+
+    for (int trial = 0; trial < 4; trial++)
+    {
+        cv::Mat codes8 = randomCodes(rng, size, CV_8U, 8);
+        cv::Mat codes16 = randomCodes(rng, size, CV_16U, 12);
+        cv::Mat mask = trial % 2 == 0 ? cv::Mat() : randomMask(rng, size);
+
+        CV_Assert(equal(single.buildSparse(codes8, mask).toDense(), single.build(codes8, mask)));
+        CV_Assert(equal(grouped.buildSparse(codes16, mask).toDense(), grouped.build(codes16, mask)));
+    }
+}
+
+// Every kernel variant the CPU supports returns the bits of the baseline kernels
+static void checkKernelVariants()
+{
+    cv::RNG rng(2);
+    const CpuIsa variants[] = {CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512, CpuIsa::NEON};
+
+    for (int trial = 0; trial < 200; trial++)
+    {
+        int length = rng.uniform(0, 700);
+        cv::Mat a(1, length + 1, CV_64F), b(1, length + 1, CV_64F);
+        rng.fill(a, cv::RNG::UNIFORM, 0.0, 1.0);
+        rng.fill(b, cv::RNG::UNIFORM, 0.0, 1.0);
+
+        double expected = kernels(CpuIsa::Baseline).l1Distance(a.ptr<double>(0), b.ptr<double>(0), length);
+        for (CpuIsa isa : variants)
+        {
+            if (isCpuIsaSupported(isa))
+            {
+                double distance = kernels(isa).l1Distance(a.ptr<double>(0), b.ptr<double>(0), length);
+                CV_Assert(std::memcmp(&distance, &expected, sizeof(double)) == 0);
+            }
+        }
+    }
+}
+
+// The sliding extractor gives the patterns of the approximated one for every moment order and a range of steps, with
+// and without a pattern mask. The constant and zero images have every response at zero, where the sliding extractor
+// falls back to direct evaluation.
+static void checkSlidingPatterns()
+{
+    cv::RNG rng(3);
+    const int patchSize = 16;
+
+    cv::Mat noise(160, 200, CV_8U);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+    std::vector<cv::Mat> images = {noise, cv::Mat(160, 200, CV_8U, cv::Scalar(128)), cv::Mat::zeros(160, 200, CV_8U)};
+
+    // Masks whole blocks of cores on every side, and single cores at the edges of the rectangle
+    cv::Mat mask = cv::Mat::zeros(noise.size(), CV_8U);
+    mask(cv::Rect(37, 29, 111, 83)).setTo(255);
+
+    for (int order = 1; order <= PatternImageExtractor::MAX_MOMENT_ORDER; order++)
+    {
+        for (int step = 1; step <= 4; step++)
+        {
+            ApproximatedPatternImageExtractor approximated(patchSize, step * patchSize / 4, order);
+            SlidingPatternImageExtractor sliding(patchSize, step * patchSize / 4, order);
+
+            for (const cv::Mat &image : images)
+            {
+                for (const cv::Mat &patternMask : {cv::Mat(), approximated.patternMask(mask)})
+                {
+                    CV_Assert(equal(sliding.extract(image, patternMask), approximated.extract(image, patternMask)));
+                }
+            }
+        }
+    }
+}
+
+static int run(const char *name, void (*check)())
+{
+    try
+    {
+        check();
+    }
+    catch (const cv::Exception &e)
+    {
+        std::cout << "FAILED " << name << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed " << name << std::endl;
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+    failures += run("sparse histogram", checkSparseHistogram);
+    failures += run("kernel variants", checkKernelVariants);
+    failures += run("sliding patterns", checkSlidingPatterns);
+
+    return failures == 0 ? 0 : -1;
+}
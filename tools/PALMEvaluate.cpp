@@ -0,0 +1,459 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "ToolCommon.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Measures place recognition accuracy and speed of PALM configurations. The input is either an image sequence
+// with ground truth loop pairs, or synthetic revisits of base images with controlled shifts and illumination
+// changes. For every configuration one CSV row is written with the precision-recall summary, the per-stage
+// latencies and the memory footprint, so that all configurations can be put on one speed/accuracy chart.
+
+typedef std::chrono::steady_clock Clock;
+
+class EvaluationSet
+{
+public:
+    std::vector<cv::Mat> images;
+    std::set<std::pair<int, int>> loops; // Ground truth pairs (i, j) with i < j
+};
+
+class EvaluationResult
+{
+public:
+    double extractMs;
+    double histogramMs;
+    double matchUs;
+    double averagePrecision;
+    double recallAtFullPrecision;
+    long long descriptorBytes;
+    long long patternBytes;
+    long peakMemoryKb; // -1 where it cannot be measured
+    bool failed;       // The evaluation threw or its child process did not exit cleanly; the measures are unset
+};
+
+static void printUsage()
+{
+    std::cout << "Usage: PALMEvaluate [options]" << std::endl
+              << "  --images PATH              image directory or list file" << std::endl
+              << "  --loops FILE               ground truth loop pairs, one \"i j\" pair of image indices per line"
+              << std::endl
+              << "  --synthetic N              evaluate N synthetic revisits of the images (or of generated scenes)"
+              << std::endl
+              << "  --shift N                  maximum synthetic shift in pixels (default 16)" << std::endl
+              << "  --illumination X           maximum synthetic gain change, 0.4 means 0.6 to 1.4 (default 0.4)"
+              << std::endl
+              << "  --exclude N                ignore pairs less than N images apart (default 0)" << std::endl
+              << "  --config P,G,S,O,F,I[,B]   patch, grid, step, order, filter, inside partitioning (0 or 1) and"
+              << std::endl
+              << "                             optionally the code bits per sub-histogram;" << std::endl
+              << "                             may be repeated, a small sweep is used by default" << std::endl
+              << "  --output FILE              CSV output (default: standard output)" << std::endl;
+}
+
+static palm::PALMConfig parseConfig(const std::string &text)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(text);
+    std::string field;
+    while (std::getline(stream, field, ','))
+    {
+        fields.push_back(field);
+    }
+    CV_Assert(fields.size() == 6 || fields.size() == 7);
+
+    palm::PALMConfig config;
+    config.patchSize = std::atoi(fields[0].c_str());
+    config.gridSize = std::atoi(fields[1].c_str());
+    config.stepSize = std::atoi(fields[2].c_str());
+    config.momentOrder = std::atoi(fields[3].c_str());
+    config.filterType = parseFilterType(fields[4]);
+    config.applyInsidePartitioning = std::atoi(fields[5].c_str()) != 0;
+    if (fields.size() == 7)
+    {
+        config.codeGroupBits = std::atoi(fields[6].c_str());
+    }
+
+    return config;
+}
+
+static std::vector<palm::PALMConfig> defaultConfigs()
+{
+    static const char *configs[] = {"32,5,8,2,regular,1", "32,5,8,2,approximated,1", "32,5,8,2,integral,1",
+                                    "32,5,8,2,sliding,1", "32,5,16,2,approximated,1", "32,5,8,2,approximated,0",
+                                    "32,4,8,2,approximated,1", "32,5,8,4,approximated,1,6",
+                                    "32,5,8,4,approximated,1,8", "32,5,8,4,sliding,1,8"};
+
+    std::vector<palm::PALMConfig> result;
+    for (const char *config : configs)
+    {
+        result.push_back(parseConfig(config));
+    }
+
+    return result;
+}
+
+// Textured scene made of smooth blobs and fine noise, used when no base images are given
+static cv::Mat generateScene(cv::RNG &rng, cv::Size size)
+{
+    cv::Mat coarse(size.height / 16, size.width / 16, CV_8U);
+    rng.fill(coarse, cv::RNG::UNIFORM, 0, 256);
+
+    cv::Mat scene;
+    cv::resize(coarse, scene, size, 0, 0, cv::INTER_CUBIC);
+
+    cv::Mat noise(size, CV_16S), noisy;
+    rng.fill(noise, cv::RNG::NORMAL, 0, 12);
+    scene.convertTo(noisy, CV_16S);
+    noisy += noise;
+    noisy.convertTo(scene, CV_8U);
+
+    return scene;
+}
+
+// Revisit of a scene: a random shift with reflected borders followed by a random gain and bias
+static cv::Mat generateRevisit(cv::RNG &rng, const cv::Mat &scene, int maxShift, double maxGainChange)
+{
+    cv::Mat transform = (cv::Mat_<double>(2, 3) << 1, 0, rng.uniform(-maxShift, maxShift + 1),
+                                                   0, 1, rng.uniform(-maxShift, maxShift + 1));
+
+    cv::Mat shifted;
+    cv::warpAffine(scene, shifted, transform, scene.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+    double gain = 1.0 + rng.uniform(-maxGainChange, maxGainChange);
+    double bias = rng.uniform(-20.0, 20.0);
+
+    cv::Mat revisit;
+    shifted.convertTo(revisit, CV_8U, gain, bias);
+
+    return revisit;
+}
+
+// Synthetic set: the base images followed by one revisit of each, every base image forms a loop with its revisit
+static EvaluationSet generateSet(const std::vector<cv::Mat> &bases, int count, int maxShift, double maxGainChange)
+{
+    cv::RNG rng(12345);
+    EvaluationSet set;
+
+    // Repeating a base image would create unlabeled loops
+    if (!bases.empty())
+    {
+        count = std::min(count, (int) bases.size());
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        set.images.push_back(bases.empty() ? generateScene(rng, cv::Size(320, 320)) : bases[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        set.images.push_back(generateRevisit(rng, set.images[i], maxShift, maxGainChange));
+        set.loops.insert(std::make_pair(i, count + i));
+    }
+
+    return set;
+}
+
+static std::set<std::pair<int, int>> loadLoops(const std::string &path)
+{
+    std::set<std::pair<int, int>> loops;
+
+    std::ifstream file(path.c_str());
+    CV_Assert(file.is_open());
+
+    int i, j;
+    while (file >> i >> j)
+    {
+        loops.insert(std::make_pair(std::min(i, j), std::max(i, j)));
+    }
+
+    return loops;
+}
+
+static double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static EvaluationResult evaluate(const palm::PALMConfig &config, const EvaluationSet &set, int exclude)
+{
+    palm::PALM palm(config, true);
+    EvaluationResult result;
+
+    int count = (int) set.images.size();
+    std::vector<cv::Mat> descriptors((size_t) count);
+    double extractMs = 0, histogramMs = 0;
+    long long patternBytes = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        Clock::time_point start = Clock::now();
+        cv::Mat patterns = palm.extractPatterns(set.images[i]);
+        extractMs += elapsedMs(start);
+
+        start = Clock::now();
+        descriptors[i] = palm.buildDescriptor(patterns);
+        histogramMs += elapsedMs(start);
+
+        patternBytes += (long long) (patterns.total() * patterns.elemSize());
+    }
+
+    // Every pair outside the exclusion window is scored; the loop pairs are the positives
+    std::vector<std::pair<double, bool>> scores;
+    Clock::time_point start = Clock::now();
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = i + std::max(exclude, 1); j < count; j++)
+        {
+            bool loop = set.loops.count(std::make_pair(i, j)) > 0;
+            scores.push_back(std::make_pair(palm.distance(descriptors[i], descriptors[j]), loop));
+        }
+    }
+
+    double matchMs = elapsedMs(start);
+    // Tied distances keep the pair order, so the curve does not depend on the sort implementation
+    typedef std::pair<double, bool> Score;
+    std::stable_sort(scores.begin(), scores.end(), [](const Score &a, const Score &b) { return a.first < b.first; });
+
+    // Precision-recall curve by sweeping the distance threshold; the area is the average precision
+    long long positives = 0;
+    for (size_t s = 0; s < scores.size(); s++)
+    {
+        positives += scores[s].second;
+    }
+
+    long long truePositives = 0;
+    double averagePrecision = 0, recallAtFullPrecision = 0;
+    bool perfect = true;
+
+    for (size_t s = 0; s < scores.size() && positives > 0; s++)
+    {
+        if (scores[s].second)
+        {
+            truePositives++;
+            averagePrecision += (double) truePositives / (s + 1);
+        }
+        else
+        {
+            perfect = false;
+        }
+
+        if (perfect)
+        {
+            recallAtFullPrecision = (double) truePositives / positives;
+        }
+    }
+
+    result.extractMs = extractMs / count;
+    result.histogramMs = histogramMs / count;
+    result.matchUs = scores.empty() ? 0.0 : 1000.0 * matchMs / scores.size();
+    result.averagePrecision = positives > 0 ? averagePrecision / positives : 0.0;
+    result.recallAtFullPrecision = recallAtFullPrecision;
+    result.descriptorBytes = (long long) palm.descriptorSize() * sizeof(double);
+    result.patternBytes = patternBytes / count;
+    result.failed = false;
+
+    return result;
+}
+
+static EvaluationResult failedResult()
+{
+    EvaluationResult result = EvaluationResult();
+    result.peakMemoryKb = -1;
+    result.failed = true;
+
+    return result;
+}
+
+// Evaluates a configuration in a child process, whose peak resident memory then belongs to this configuration
+// alone instead of being the maximum over the whole run. It includes the evaluation set inherited from the parent,
+// which is the same for every configuration. Elsewhere the configuration is evaluated in this process without it.
+// The child is forked from a process without OpenCV worker threads, see main().
+static EvaluationResult evaluateIsolated(const palm::PALMConfig &config, const EvaluationSet &set, int exclude)
+{
+#ifdef __linux__
+    int channel[2];
+    if (pipe(channel) == 0)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            close(channel[0]);
+            int status = 1;
+            try
+            {
+                EvaluationResult result = evaluate(config, set, exclude);
+                status = write(channel[1], &result, sizeof(result)) == (ssize_t) sizeof(result) ? 0 : 1;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            _exit(status);
+        }
+
+        close(channel[1]);
+        if (child > 0)
+        {
+            EvaluationResult result;
+            ssize_t received = read(channel[0], &result, sizeof(result));
+            close(channel[0]);
+
+            int status;
+            struct rusage usage;
+            if (wait4(child, &status, 0, &usage) != child || received != (ssize_t) sizeof(result) ||
+                !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                return failedResult();
+            }
+
+            result.peakMemoryKb = usage.ru_maxrss;
+            return result;
+        }
+        close(channel[0]);
+    }
+#endif
+
+    try
+    {
+        EvaluationResult result = evaluate(config, set, exclude);
+        result.peakMemoryKb = -1;
+
+        return result;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return failedResult();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // OpenCV must not start worker threads before evaluateIsolated() forks, a child could inherit a held lock
+    cv::setNumThreads(0);
+
+    std::string imagesPath, loopsPath, outputPath;
+    int synthetic = 0, maxShift = 16, exclude = 0;
+    double maxGainChange = 0.4;
+    std::vector<palm::PALMConfig> configs;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string option = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (option == "--images" && hasValue)
+            imagesPath = argv[++a];
+        else if (option == "--loops" && hasValue)
+            loopsPath = argv[++a];
+        else if (option == "--synthetic" && hasValue)
+            synthetic = std::atoi(argv[++a]);
+        else if (option == "--shift" && hasValue)
+            maxShift = std::atoi(argv[++a]);
+        else if (option == "--illumination" && hasValue)
+            maxGainChange = std::atof(argv[++a]);
+        else if (option == "--exclude" && hasValue)
+            exclude = std::atoi(argv[++a]);
+        else if (option == "--config" && hasValue)
+            configs.push_back(parseConfig(argv[++a]));
+        else if (option == "--output" && hasValue)
+            outputPath = argv[++a];
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if ((synthetic <= 0 && (imagesPath.empty() || loopsPath.empty())) || exclude < 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    if (configs.empty())
+    {
+        configs = defaultConfigs();
+    }
+
+    std::vector<cv::Mat> images;
+    if (!imagesPath.empty())
+    {
+        std::vector<std::string> paths = listImages(imagesPath);
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            cv::Mat image = cv::imread(paths[i], cv::IMREAD_GRAYSCALE);
+            if (image.empty())
+            {
+                std::cerr << "Cannot read " << paths[i] << std::endl;
+                return -1;
+            }
+            images.push_back(image);
+        }
+    }
+
+    EvaluationSet set;
+    if (synthetic > 0)
+    {
+        set = generateSet(images, synthetic, maxShift, maxGainChange);
+    }
+    else
+    {
+        set.images = images;
+        set.loops = loadLoops(loopsPath);
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty())
+    {
+        file.open(outputPath.c_str());
+        CV_Assert(file.is_open());
+    }
+    std::ostream &csv = outputPath.empty() ? std::cout : file;
+
+    csv << "patch,grid,step,order,filter,inside,group_bits,images,loops,extract_ms,histogram_ms,total_ms,images_per_s,"
+        << "match_us,average_precision,recall_at_full_precision,descriptor_bytes,pattern_bytes,peak_memory_kb,"
+        << "status"
+        << std::endl;
+
+    for (size_t c = 0; c < configs.size(); c++)
+    {
+        const palm::PALMConfig &config = configs[c];
+        EvaluationResult result = evaluateIsolated(config, set, exclude);
+
+        if (result.failed)
+        {
+            // The row keeps the configuration, so a failure does not end the sweep
+            std::cerr << "Configuration " << c + 1 << " failed" << std::endl;
+            csv << config.patchSize << "," << config.gridSize << "," << config.stepSize << "," << config.momentOrder
+                << "," << filterTypeName(config.filterType) << "," << (config.applyInsidePartitioning ? 1 : 0) << ","
+                << config.codeGroupBits << "," << set.images.size() << "," << set.loops.size()
+                << ",,,,,,,,,,,failed" << std::endl;
+            continue;
+        }
+
+        double totalMs = result.extractMs + result.histogramMs;
+
+        csv << config.patchSize << "," << config.gridSize << "," << config.stepSize << "," << config.momentOrder
+            << "," << filterTypeName(config.filterType) << "," << (config.applyInsidePartitioning ? 1 : 0) << ","
+            << config.codeGroupBits << ","
+            << set.images.size() << "," << set.loops.size() << "," << result.extractMs << "," << result.histogramMs
+            << "," << totalMs << "," << (totalMs > 0 ? 1000.0 / totalMs : 0.0) << "," << result.matchUs << ","
+            << result.averagePrecision << "," << result.recallAtFullPrecision << "," << result.descriptorBytes << ","
+            << result.patternBytes << "," << result.peakMemoryKb << ",ok" << std::endl;
+    }
+
+    return 0;
+}
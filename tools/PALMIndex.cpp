@@ -0,0 +1,359 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+#include "DescriptorFile.h"
+#include "MapSummarizer.h"
+#include "ToolCommon.h"
+
+// Builds a descriptor file from a directory or a list file of images. Images are decoded and described by a pool
+// of worker threads and written in input order, so an interrupted run continues after the last complete record.
+// Optionally the records are also summarized into one representative per place (see MapSummarizer); frame f of the
+// summary is record f of the descriptor file.
+
+static void printUsage()
+{
+    std::cout << "Usage: PALMIndex <image directory | list file> <output file> [options]" << std::endl
+              << "  --patch N                  patch size (default 32)" << std::endl
+              << "  --grid N                   grid size (default 5)" << std::endl
+              << "  --step N                   step size (default 8)" << std::endl
+              << "  --order N                  moment order (default 2)" << std::endl
+              << "  --filter NAME              regular, approximated, integral or sliding (default approximated)"
+              << std::endl
+              << "  --no-inside-partitioning   disable the slided grid" << std::endl
+              << "  --group-bits N             code bits per sub-histogram (default 8)" << std::endl
+              << "  --threads N                worker threads (default: hardware threads)" << std::endl
+              << "  --summary FILE X           also write a map summary that merges records closer than X" << std::endl
+              << "  --summary-mean             summary representatives are the mean of their records" << std::endl
+              << "  --restart                  overwrite the output instead of resuming it" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return -1;
+    }
+
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+
+    palm::PALMConfig config;
+    config.momentOrder = 2;
+    config.gridSize = 5;
+    config.stepSize = 8;
+    config.patchSize = 32;
+    config.filterType = palm::FilterType::Approximated;
+    config.applyInsidePartitioning = true;
+
+    int threadCount = std::max(1, (int) std::thread::hardware_concurrency());
+    bool resume = true;
+    std::string summaryPath;
+    double summaryThreshold = 0;
+    palm::MergePolicy mergePolicy = palm::MergePolicy::KeepFirst;
+
+    for (int a = 3; a < argc; a++)
+    {
+        std::string option = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (option == "--patch" && hasValue)
+            config.patchSize = std::atoi(argv[++a]);
+        else if (option == "--grid" && hasValue)
+            config.gridSize = std::atoi(argv[++a]);
+        else if (option == "--step" && hasValue)
+            config.stepSize = std::atoi(argv[++a]);
+        else if (option == "--order" && hasValue)
+            config.momentOrder = std::atoi(argv[++a]);
+        else if (option == "--filter" && hasValue)
+            config.filterType = parseFilterType(argv[++a]);
+        else if (option == "--no-inside-partitioning")
+            config.applyInsidePartitioning = false;
+        else if (option == "--group-bits" && hasValue)
+            config.codeGroupBits = std::atoi(argv[++a]);
+        else if (option == "--threads" && hasValue)
+            threadCount = std::max(1, std::atoi(argv[++a]));
+        else if (option == "--restart")
+            resume = false;
+        else if (option == "--summary" && a + 2 < argc)
+        {
+            summaryPath = argv[++a];
+            summaryThreshold = std::atof(argv[++a]);
+        }
+        else if (option == "--summary-mean")
+            mergePolicy = palm::MergePolicy::RunningMean;
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    std::vector<std::string> paths = listImages(inputPath);
+    if (paths.empty())
+    {
+        std::cout << "No images found in " << inputPath << std::endl;
+        return -1;
+    }
+
+    // Every worker owns its PALM object, since compute() keeps the last pattern image
+    std::vector<cv::Ptr<palm::PALM>> palms;
+    for (int t = 0; t < threadCount; t++)
+    {
+        palms.push_back(new palm::PALM(config, true));
+    }
+
+    palm::DescriptorFileWriter writer;
+    long long existing;
+    try
+    {
+        existing = writer.open(outputPath, config, palms[0]->descriptorSize(), resume);
+    }
+    catch (const cv::Exception &e)
+    {
+        std::cout << "Cannot open " << outputPath << ": " << e.what() << std::endl
+                  << "A file written with another configuration can be overwritten with --restart" << std::endl;
+        return -1;
+    }
+
+    long long first = writer.lastIndex() + 1;
+    long long count = (long long) paths.size();
+
+    // Record indices refer to the input list, so a resumed file must have been built from the same list
+    if (first > 0 && (first > count || paths[first - 1] != writer.lastPath()))
+    {
+        std::cout << "Cannot resume " << outputPath << ", its last record " << writer.lastPath() << " is not image "
+                  << first - 1 << " of the input (use --restart to overwrite it)" << std::endl;
+        return -1;
+    }
+    if (first > 0)
+    {
+        std::cout << "Resuming after " << existing << " records, at image " << first << " of " << count << std::endl;
+    }
+
+    cv::Ptr<palm::MapSummarizer> summarizer;
+    if (!summaryPath.empty())
+    {
+        const palm::BoundedL1Distance &distance = *palms[0]->boundedDistance();
+
+        // A summary saved with the records written so far is continued, any other one is rebuilt from the records
+        if (existing > 0)
+        {
+            try
+            {
+                summarizer = palm::MapSummarizer::load(summaryPath);
+            }
+            catch (const cv::Exception &)
+            {
+                summarizer = nullptr;
+            }
+
+            if (summarizer != nullptr && (summarizer->descriptorSize() != distance.descriptorSize() ||
+                                          summarizer->distance().getCellLength() != distance.getCellLength() ||
+                                          summarizer->getThreshold() != summaryThreshold ||
+                                          summarizer->getMergePolicy() != mergePolicy ||
+                                          summarizer->frameCount() != existing))
+            {
+                summarizer = nullptr;
+            }
+        }
+
+        if (summarizer == nullptr)
+        {
+            summarizer = new palm::MapSummarizer(distance.descriptorSize(), distance.getCellLength(),
+                                                 summaryThreshold, mergePolicy);
+
+            if (existing > 0)
+            {
+                palm::DescriptorFileReader reader;
+                reader.open(outputPath);
+
+                palm::DescriptorRecord record;
+                while (reader.read(record))
+                {
+                    summarizer->add(record.descriptor);
+                }
+            }
+        }
+    }
+
+    // Results are parked in a bounded reorder window until every earlier image has been written
+    const long long window = 4 * threadCount;
+
+    std::mutex mutex;
+    std::condition_variable written, ready;
+    std::map<long long, palm::DescriptorRecord> pending;
+    std::map<long long, std::string> errors; // Why an image has no descriptor, if not because it was unreadable
+    long long nextWrite = first;
+    bool stopped = false; // Set when writing fails, so the workers stop and can be joined
+    std::atomic<long long> nextRead(first);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++)
+    {
+        workers.push_back(std::thread([&, t]()
+        {
+            for (;;)
+            {
+                long long index = nextRead++;
+                if (index >= count)
+                {
+                    break;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    written.wait(lock, [&]() { return stopped || index < nextWrite + window; });
+                    if (stopped)
+                    {
+                        break;
+                    }
+                }
+
+                palm::DescriptorRecord record;
+                record.index = index;
+                record.path = paths[index];
+
+                // An image the configuration cannot describe, e.g. one smaller than the patch, is skipped. Any other
+                // failure skips the image as well instead of escaping the thread.
+                std::string error;
+                try
+                {
+                    cv::Mat image = cv::imread(record.path, cv::IMREAD_GRAYSCALE);
+                    if (!image.empty())
+                    {
+                        record.descriptor = palms[t]->compute(image);
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    record.descriptor = cv::Mat();
+                    error = e.what();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending[index] = record;
+                    if (!error.empty())
+                    {
+                        errors[index] = error;
+                    }
+                }
+                ready.notify_one();
+            }
+        }));
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point lastReport = start;
+    long long processed = 0, skipped = 0;
+    bool failed = false;
+    std::string failure;
+
+    try
+    {
+        while (nextWrite < count)
+        {
+            palm::DescriptorRecord record;
+            std::string error;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return pending.count(nextWrite) > 0; });
+
+                record = pending[nextWrite];
+                pending.erase(nextWrite);
+                if (errors.count(nextWrite) > 0)
+                {
+                    error = errors[nextWrite];
+                    errors.erase(nextWrite);
+                }
+            }
+
+            if (record.descriptor.empty())
+            {
+                // The index stays reserved, so records keep pointing at their line in the input list
+                if (error.empty())
+                {
+                    std::cerr << "Skipping unreadable image " << record.path << std::endl;
+                }
+                else
+                {
+                    std::cerr << "Skipping image " << record.path << ": " << error << std::endl;
+                }
+                skipped++;
+            }
+            else
+            {
+                writer.write(record);
+                if (summarizer != nullptr)
+                {
+                    summarizer->add(record.descriptor);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                nextWrite++;
+            }
+            written.notify_all();
+            processed++;
+
+            Clock::time_point now = Clock::now();
+            if (now - lastReport >= std::chrono::seconds(2))
+            {
+                double elapsed = std::chrono::duration<double>(now - start).count();
+                std::cout << nextWrite << " / " << count << " images, " << processed / elapsed << " images/s"
+                          << std::endl;
+
+                writer.flush();
+                lastReport = now;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        failed = true;
+        failure = e.what();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        nextRead = count;
+    }
+    written.notify_all();
+
+    // The workers are joined before any return, a joinable thread would end the process
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    writer.close();
+
+    // Saved also after a failure, so a resumed run can continue the summary
+    if (summarizer != nullptr)
+    {
+        summarizer->save(summaryPath);
+        std::cout << "Summarized " << summarizer->frameCount() << " records into " << summarizer->size()
+                  << " places" << std::endl;
+    }
+
+    if (failed)
+    {
+        std::cout << "Indexing stopped at image " << nextWrite << ": " << failure << std::endl
+                  << "The records written so far are kept, the run can be resumed" << std::endl;
+        return -1;
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Indexed " << processed - skipped << " images (" << skipped << " skipped) in " << elapsed << " s, "
+              << (elapsed > 0 ? processed / elapsed : 0.0) << " images/s" << std::endl;
+
+    return 0;
+}
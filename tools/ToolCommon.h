@@ -0,0 +1,116 @@
+#ifndef PALM_TOOLCOMMON_H
+#define PALM_TOOLCOMMON_H
+
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+#include "PALM.h"
+
+// Helpers shared by the command line tools
+
+static inline bool isDirectory(const std::string &path)
+{
+    struct stat info;
+
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+}
+
+static inline bool isImagePath(const std::string &path)
+{
+    static const char *extensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm", ".webp"};
+
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string extension = path.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    for (const char *e : extensions)
+    {
+        if (extension == e)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Lists the images of a directory in name order, or the paths of a list file with one path per line
+static inline std::vector<std::string> listImages(const std::string &input)
+{
+    std::vector<std::string> paths;
+
+    if (isDirectory(input))
+    {
+        std::vector<cv::String> files;
+        cv::glob(input, files, false);
+
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (isImagePath(files[i]))
+            {
+                paths.push_back(files[i]);
+            }
+        }
+
+        std::sort(paths.begin(), paths.end());
+    }
+    else
+    {
+        std::ifstream list(input.c_str());
+        std::string line;
+
+        while (std::getline(list, line))
+        {
+            line.erase(line.find_last_not_of(" \t\r\n") + 1);
+            if (!line.empty() && line[0] != '#')
+            {
+                paths.push_back(line);
+            }
+        }
+    }
+
+    return paths;
+}
+
+static inline palm::FilterType parseFilterType(const std::string &name)
+{
+    if (name == "regular")
+    {
+        return palm::FilterType::Regular;
+    }
+    if (name == "integral")
+    {
+        return palm::FilterType::ApproximatedIntegral;
+    }
+    if (name == "sliding")
+    {
+        return palm::FilterType::ApproximatedSliding;
+    }
+
+    CV_Assert(name == "approximated");
+
+    return palm::FilterType::Approximated;
+}
+
+static inline std::string filterTypeName(palm::FilterType filterType)
+{
+    switch (filterType)
+    {
+        case palm::FilterType::Regular:
+            return "regular";
+        case palm::FilterType::ApproximatedIntegral:
+            return "integral";
+        case palm::FilterType::ApproximatedSliding:
+            return "sliding";
+        case palm::FilterType::Approximated:
+        default:
+            return "approximated";
+    }
+}
+
+#endif //PALM_TOOLCOMMON_H